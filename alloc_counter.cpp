@@ -0,0 +1,73 @@
+#include "alloc_counter.h"
+#include<cstdlib>
+#include<new>
+
+std::atomic<long long> allocations(0);
+
+static void *allocate(size_t size){
+	++allocations;
+	if(void *p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new(size_t size){
+	return allocate(size);
+}
+void *operator new[](size_t size){
+	return allocate(size);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept{
+	try { return allocate(size); } catch(const std::bad_alloc &) { return nullptr; }
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept{
+	try { return allocate(size); } catch(const std::bad_alloc &) { return nullptr; }
+}
+void operator delete(void *p) noexcept{
+	free(p);
+}
+void operator delete[](void *p) noexcept{
+	free(p);
+}
+void operator delete(void *p, size_t) noexcept{
+	free(p);
+}
+void operator delete[](void *p, size_t) noexcept{
+	free(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept{
+	free(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept{
+	free(p);
+}
+
+#ifdef __cpp_aligned_new
+//over-aligned types (the hash table's cache line buckets), aligned_alloc wants the size to be a multiple of the alignment
+static void *allocateAligned(size_t size, std::align_val_t align){
+	++allocations;
+	size_t a = (size_t)align;
+	if(void *p = aligned_alloc(a, size ? (size + a - 1) / a * a : a))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t align){
+	return allocateAligned(size, align);
+}
+void *operator new[](size_t size, std::align_val_t align){
+	return allocateAligned(size, align);
+}
+void operator delete(void *p, std::align_val_t) noexcept{
+	free(p);
+}
+void operator delete[](void *p, std::align_val_t) noexcept{
+	free(p);
+}
+void operator delete(void *p, size_t, std::align_val_t) noexcept{
+	free(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept{
+	free(p);
+}
+#endif
@@ -0,0 +1,10 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include<atomic>
+
+//heap allocations made so far by the process: linking alloc_counter.cpp replaces the global operator new and delete
+//with ones that count, so benchmarks can check that the code they time doesn't allocate
+extern std::atomic<long long> allocations;
+
+#endif
@@ -0,0 +1,244 @@
+/* Search benchmark: time to depth over a fixed set of positions, for 1, 2, 4... search threads.
+	allocs counts heap allocations during the searches: none with one thread, one per helper thread started otherwise
+	cut1st is the share of beta cutoffs that came from the first move searched
+	build: g++ -O2 -pthread bench.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp alloc_counter.cpp -o bench
+	evals/s is the static evaluation speed, recounts/s the speed of a full piece square sum
+	(which must agree with the sum set() keeps up to date)
+	the technique table searches the positions with none of pvs, aspiration windows, null move and lmr, each alone, and all of them
+	usage: bench [depth] [max_threads] [hash_mb]
+	   or: bench scaling [depth] [hash_mb]
+	the scaling mode only times the searches, with 1, 2, 4 and 8 threads whatever the cores, taking the median of a few runs
+	(lazy SMP can only speed up on free cores, rows with more threads than the machine has cores are marked)
+*/
+#include "alloc_counter.h"
+#include "chess.h"
+#include "eval.h"
+#include "tt.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+
+#define SCALING_RUNS 3		//runs per thread count in the scaling mode, lazy SMP timings vary from run to run
+
+//openings played out from the start position, in coordinate notation
+const char *positions[] = {
+	"",
+	"e2e4 e7e5 g1f3 b8c6 f1c4 f8c5 c2c3 g8f6 d2d3 d7d6",
+	"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 f8e7 e2e3 e8g8",
+	"e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6",
+	"d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6 g1f3 e8g8 f1e2 e7e5",
+	"e2e4 e7e6 d2d4 d7d5 b1c3 f8b4 e4e5 c7c5 a2a3 b4c3 b2c3 g8e7",
+};
+
+//the side to move has one clearly best move: opening traps, and exchanges on a square whose last capture lies past the
+//horizon at bench depths, so they're only won with the capture search at the leaves
+struct Tactic{
+	const char *moves, *best;		//moves from the start position, or a FEN
+};
+const Tactic tactics[] = {
+	{"e2e4 e7e5 f1c4 b8c6 d1h5 g8f6", "h5f7"},										//scholar's mate
+	{"f2f3 e7e5 g2g4", "d8h4"},														//fool's mate
+	{"e2e4 e7e5 g1f3 b8c6 f1c4 c6d4 f3e5 d8g5 e5f7 g5g2 h1f1 g2e4 c4e2", "d4f3"},	//blackburne shilling gambit
+	{"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 b8d7 c4d5 e6d5 c3d5", "f6d5"},				//elephant trap
+	{"3r2k1/pppr1ppp/5n2/3p4/8/2NR4/PPPR1PPP/3Q2K1 w - - 0 1", "c3d5"},			//seven captures on d5, only Nxd5 wins the pawn
+	{"3rr1k1/ppp2ppp/5n2/3p4/8/2NR4/PPPR1PPP/3Q2K1 w - - 0 1", "c3d5"},			//five captures on d5
+};
+
+//plays moves like "e2e4" from the start position, or sets up a FEN
+Board setupPosition(const char *moves){
+	Board board;
+	if(strchr(moves, '/')){
+		board.setFen(moves);
+		return board;
+	}
+	std::istringstream in(moves);
+	std::string m;
+	while(in >> m)
+		board.makeMove(parseMove(board, m));
+	return board;
+}
+
+//time to depth over the positions with the given search threads, each position from an empty hash table
+struct ThreadRun{
+	double time = 0;		//ms
+	long long nodes = 0, allocs = 0, cutoffs = 0, first_cutoffs = 0;
+};
+ThreadRun searchPositions(int depth, int threads){
+	ThreadRun run;
+	for(const char *moves : positions){
+		Board board = setupPosition(moves);
+		transpositionTable.clear();
+
+		SearchLimits limits;
+		limits.depth = depth;
+		limits.threads = threads;
+		SearchInfo info;
+		Coordinate from, to;
+
+		long long allocs_before = allocations;
+		auto start = std::chrono::steady_clock::now();
+		getMoveToMake(from, to, board, limits, board.turn, &info);
+		run.time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		run.allocs += allocations - allocs_before;
+		run.cutoffs += info.cutoffs;
+		run.first_cutoffs += info.first_cutoffs;
+		run.nodes += info.nodes;
+	}
+	return run;
+}
+
+//speedup of 1, 2, 4 and 8 threads over 1, by the median time to depth of a few runs
+int scaling(int depth, int hash_mb){
+	unsigned cores = std::thread::hardware_concurrency();
+	transpositionTable.resize(hash_mb);
+	printf("thread scaling, depth %d, %d positions, %d MB hash, %u cores, median of %d runs\n", depth,
+			(int)(sizeof(positions) / sizeof(*positions)), hash_mb, cores, SCALING_RUNS);
+	printf("%8s %10s %12s %12s %8s\n", "threads", "time (ms)", "nodes", "nps", "speedup");
+
+	double base_time = 0;
+	for(int threads : {1, 2, 4, 8}){
+		ThreadRun runs[SCALING_RUNS];
+		for(ThreadRun &run : runs)
+			run = searchPositions(depth, threads);
+		std::sort(runs, runs + SCALING_RUNS, [](const ThreadRun &a, const ThreadRun &b){ return a.time < b.time; });
+		const ThreadRun &median = runs[SCALING_RUNS / 2];
+		if(threads == 1)
+			base_time = median.time;
+		printf("%8d %10.0f %12lld %12.0f %8.2f%s\n", threads, median.time, median.nodes, median.nodes / (median.time / 1000),
+				base_time / median.time, (unsigned)threads > cores ? "   more threads than cores" : "");
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]){
+	if(argc > 1 && !strcmp(argv[1], "scaling"))
+		return scaling(argc > 2 ? atoi(argv[2]) : 8, argc > 3 ? atoi(argv[3]) : 64);
+
+	int depth = argc > 1 ? atoi(argv[1]) : 6;
+	int max_threads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+	int hash_mb = argc > 3 ? atoi(argv[3]) : 64;
+	if(max_threads < 1)
+		max_threads = 1;
+
+	transpositionTable.resize(hash_mb);
+
+	printf("depth %d, %d positions, %d MB hash\n", depth, (int)(sizeof(positions) / sizeof(*positions)), hash_mb);
+	printf("%8s %10s %12s %12s %8s %8s %8s\n", "threads", "time (ms)", "nodes", "nps", "speedup", "allocs", "cut1st");
+
+	double base_time = 0;
+	for(int threads = 1; threads <= max_threads; threads *= 2){
+		ThreadRun run = searchPositions(depth, threads);
+		if(threads == 1)
+			base_time = run.time;
+		printf("%8d %10.0f %12lld %12.0f %8.2f %8lld %7.1f%%\n", threads, run.time, run.nodes, run.nodes / (run.time / 1000),
+				base_time / run.time, run.allocs, run.cutoffs ? 100.0 * run.first_cutoffs / run.cutoffs : 0.0);
+	}
+
+	//node and time savings of each search technique against plain alpha-beta, 1 thread
+	struct Technique{
+		const char *name;
+		bool pvs, aspiration, null_move, lmr;
+	};
+	const Technique techniques[] = {
+		{"none", false, false, false, false},
+		{"pvs", true, false, false, false},
+		{"aspiration", false, true, false, false},
+		{"null move", false, false, true, false},
+		{"lmr", false, false, false, true},
+		{"all", true, true, true, true},
+	};
+	printf("\nsearch techniques, depth %d, 1 thread\n", depth);
+	printf("%12s %10s %12s %8s %8s\n", "technique", "time (ms)", "nodes", "nodes%", "speedup");
+	long long base_nodes = 0;
+	for(const Technique &tech : techniques){
+		long long nodes = 0;
+		double total = 0;
+		for(const char *moves : positions){
+			Board board = setupPosition(moves);
+			transpositionTable.clear();
+
+			SearchLimits limits;
+			limits.depth = depth;
+			limits.pvs = tech.pvs;
+			limits.aspiration = tech.aspiration;
+			limits.null_move = tech.null_move;
+			limits.lmr = tech.lmr;
+			SearchInfo info;
+			Coordinate from, to;
+
+			auto start = std::chrono::steady_clock::now();
+			getMoveToMake(from, to, board, limits, board.turn, &info);
+			total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			nodes += info.nodes;
+		}
+		if(!base_nodes){
+			base_nodes = nodes;
+			base_time = total;
+		}
+		printf("%12s %10.0f %12lld %7.1f%% %8.2f\n", tech.name, total, nodes, 100.0 * nodes / base_nodes, base_time / total);
+	}
+
+	//the tactics at full and reduced depth, with and without the capture search at the leaves
+	printf("\n%d tactics, 1 thread\n", (int)(sizeof(tactics) / sizeof(*tactics)));
+	printf("%10s %6s %8s %10s %12s\n", "quiescence", "depth", "solved", "time (ms)", "nodes");
+	for(int quiescence = 0; quiescence < 2; ++quiescence){
+		for(int d = depth - 2; d <= depth; d += 2){
+			if(d < 1)
+				continue;
+			long long nodes = 0;
+			int solved = 0;
+			double total = 0;
+			for(const Tactic &t : tactics){
+				Board board = setupPosition(t.moves);
+				transpositionTable.clear();
+
+				SearchLimits limits;
+				limits.depth = d;
+				limits.quiescence = quiescence;
+				SearchInfo info;
+				Coordinate from, to;
+
+				auto start = std::chrono::steady_clock::now();
+				getMoveToMake(from, to, board, limits, board.turn, &info);
+				total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				nodes += info.nodes;
+				solved += moveToString(info.move) == t.best;
+			}
+			printf("%10s %6d %8d %10.0f %12lld\n", quiescence ? "on" : "off", d, solved, total, nodes);
+		}
+	}
+
+	//static evaluation over all the positions, then the full piece square recount
+	std::vector<Board> boards;
+	for(const char *moves : positions)
+		boards.push_back(setupPosition(moves));
+	for(const Tactic &t : tactics)
+		boards.push_back(setupPosition(t.moves));
+	auto rate = [&](int (*f)(Board &)){
+		long long calls = 0, sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		double elapsed;
+		do {
+			for(Board &b : boards)
+				sum += f(b);
+			calls += boards.size();
+			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while(elapsed < 0.5);
+		if(sum == 42)		//keeps the loop from being optimized out
+			printf(" ");
+		return calls / elapsed;
+	};
+	bool agrees = true;
+	for(Board &b : boards)
+		agrees = agrees && b.computePstSum() == b.psq;
+	printf("\nevaluation, %d positions: %.0f evals/s\n", (int)boards.size(), rate([](Board &b){ return evaluate(b); }));
+	printf("piece square recount: %.0f recounts/s, agrees %s\n", rate([](Board &b){ return b.computePstSum(); }), agrees ? "yes" : "NO");
+	return 0;
+}
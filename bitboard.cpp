@@ -0,0 +1,164 @@
+#include "bitboard.h"
+
+Magic rookMagics[64], bishopMagics[64];
+
+static Bitboard rookTable[0x19000], bishopTable[0x1480];
+
+static constexpr int knightSteps[][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+static constexpr int kingSteps[][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+static constexpr int pawnSteps[2][2][2] = {{{-1, 1}, {1, 1}}, {{-1, -1}, {1, -1}}};
+static constexpr int straight[][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+static constexpr int diagonal[][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+static constexpr bool onBoard(int file, int rank){
+	return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+}
+
+//jump set of a leaper from sq (files/ranks offsets, a1 = 0)
+static constexpr Bitboard leaperAttacks(int sq, const int steps[][2], int count){
+	Bitboard attacks = 0;
+	for(int i = 0; i < count; ++i){
+		int file = (sq & 7) + steps[i][0], rank = (sq >> 3) + steps[i][1];
+		if(onBoard(file, rank))
+			attacks |= squareBB(file + 8*rank);
+	}
+	return attacks;
+}
+
+//walks the rays one step at a time till a blocker (only used to fill the tables)
+static constexpr Bitboard slidingAttacks(int sq, Bitboard occupied, const int directions[][2]){
+	Bitboard attacks = 0;
+	for(int i = 0; i < 4; ++i){
+		int file = (sq & 7) + directions[i][0], rank = (sq >> 3) + directions[i][1];
+		for(; onBoard(file, rank); file += directions[i][0], rank += directions[i][1]){
+			Bitboard b = squareBB(file + 8*rank);
+			attacks |= b;
+			if(occupied & b)
+				break;
+		}
+	}
+	return attacks;
+}
+
+template<class F>
+static constexpr SquareTable makeTable(F f){
+	SquareTable table = {};
+	for(int sq = 0; sq < 64; ++sq)
+		table[sq] = f(sq);
+	return table;
+}
+
+//two squares on one rank, file or diagonal see each other on the empty board
+static constexpr std::array<SquareTable, 64> makeLineTable(bool between){
+	std::array<SquareTable, 64> table = {};
+	for(int a = 0; a < 64; ++a){
+		for(int b = 0; b < 64; ++b){
+			if(a == b)
+				continue;
+			for(auto directions : {straight, diagonal}){
+				if(!(slidingAttacks(a, 0, directions) & squareBB(b)))
+					continue;
+				table[a][b] = between ? slidingAttacks(a, squareBB(b), directions) & slidingAttacks(b, squareBB(a), directions)
+					: (slidingAttacks(a, 0, directions) & slidingAttacks(b, 0, directions)) | squareBB(a) | squareBB(b);
+			}
+		}
+	}
+	return table;
+}
+
+constexpr SquareTable knightTable = makeTable([](int sq){ return leaperAttacks(sq, knightSteps, 8); });
+constexpr SquareTable kingTable = makeTable([](int sq){ return leaperAttacks(sq, kingSteps, 8); });
+constexpr std::array<SquareTable, 2> pawnTable = {
+	makeTable([](int sq){ return leaperAttacks(sq, pawnSteps[0], 2); }),
+	makeTable([](int sq){ return leaperAttacks(sq, pawnSteps[1], 2); })
+};
+constexpr SquareTable rookRayTable = makeTable([](int sq){ return slidingAttacks(sq, 0, straight); });
+constexpr SquareTable bishopRayTable = makeTable([](int sq){ return slidingAttacks(sq, 0, diagonal); });
+constexpr std::array<SquareTable, 64> betweenTable = makeLineTable(true), lineTable = makeLineTable(false);
+
+static_assert(knightTable[0] == (squareBB(10) | squareBB(17)), "knight on a1 reaches b3 and c2");
+static_assert(betweenTable[0][63] == 0x0040201008040200ULL, "a1-h8 diagonal");
+
+//blocker mask: the rays without the board edge they run into
+static Bitboard relevantMask(int sq, const int directions[][2]){
+	Bitboard mask = 0;
+	for(int i = 0; i < 4; ++i){
+		int file = (sq & 7) + directions[i][0], rank = (sq >> 3) + directions[i][1];
+		while(onBoard(file + directions[i][0], rank + directions[i][1])){
+			mask |= squareBB(file + 8*rank);
+			file += directions[i][0];
+			rank += directions[i][1];
+		}
+	}
+	return mask;
+}
+
+#ifndef USE_PEXT
+//multipliers that hash every blocker subset of a square's mask without a destructive collision, found once by a random
+//trial search (sparse candidates, kept when all subsets fit) and fixed here so startup only fills the tables
+static constexpr Bitboard rookMagicNumbers[64] = {
+	0x008000908064c000ULL, 0x0040200040001000ULL, 0x0180100080a0010aULL, 0x8880041000800800ULL,
+	0x1200100201200804ULL, 0x0200020004011008ULL, 0x2180010000800600ULL, 0x0200005088210204ULL,
+	0x0400800040008021ULL, 0x0400400020005000ULL, 0x8240801000200080ULL, 0x8611001004200900ULL,
+	0x008180800c001800ULL, 0x0100800200800400ULL, 0x0a02000102000408ULL, 0x8020802300104280ULL,
+	0x0080004000402000ULL, 0xe010104000402000ULL, 0x0800808010002000ULL, 0xa280210008100100ULL,
+	0x0001818014000800ULL, 0xa002010100080400ULL, 0x0080240001020870ULL, 0x0001020004048845ULL,
+	0x0081826280004004ULL, 0x2020810900284000ULL, 0x0200100080802000ULL, 0x0200080080100080ULL,
+	0x8083080100100500ULL, 0x4406000901000400ULL, 0x0005020080800100ULL, 0x0090204200008114ULL,
+	0x0010400094800420ULL, 0x0900804000802002ULL, 0x0201001841002000ULL, 0x4100080080801000ULL,
+	0x4540040080800800ULL, 0x0002001004040020ULL, 0x0281195814001002ULL, 0x1240800040800100ULL,
+	0x0880042000524004ULL, 0x02c080410206002cULL, 0x0801200241050010ULL, 0x8400080010008080ULL,
+	0x0008000500090010ULL, 0x0082009084020008ULL, 0x4012000108020004ULL, 0x9000104d08860004ULL,
+	0x2004204114800100ULL, 0x0148802112400300ULL, 0x0202842000100880ULL, 0x001b080080900080ULL,
+	0x001a002008100600ULL, 0x0004008004020080ULL, 0x5181000600040300ULL, 0x0000044401128a00ULL,
+	0x8044110480002441ULL, 0x2008110084402202ULL, 0x90806005090010c1ULL, 0x000420310a004a42ULL,
+	0x0023001004020801ULL, 0x0882001008040102ULL, 0x000230088118020cULL, 0x0000019025040042ULL,
+};
+static constexpr Bitboard bishopMagicNumbers[64] = {
+	0x0008101020810010ULL, 0x0012040424045024ULL, 0x054404408a030000ULL, 0x0804041082000204ULL,
+	0x1002021004008000ULL, 0x0008413010000020ULL, 0x0046011048058800ULL, 0x2008840068020800ULL,
+	0x0241200450108100ULL, 0x0410105408842044ULL, 0x0002040800890208ULL, 0x1002040424830122ULL,
+	0x0008084840022204ULL, 0x0102010402400000ULL, 0x0048010802108604ULL, 0x1010084402011005ULL,
+	0x0222018820044088ULL, 0x0010144841080080ULL, 0xa004064818001010ULL, 0x7006010409220002ULL,
+	0x4004050c80a00012ULL, 0x0600400208024008ULL, 0x00420007082a0208ULL, 0x0000421424045c00ULL,
+	0x0020100004100230ULL, 0x0448211002820200ULL, 0x0040404384040080ULL, 0x008108000a0a0040ULL,
+	0x6042040026010841ULL, 0x0010120841010100ULL, 0x820c440212848448ULL, 0x00041f0100819480ULL,
+	0x110c108804042108ULL, 0x0001100300105400ULL, 0x0004004400080024ULL, 0x8002004040040100ULL,
+	0x400408020049a008ULL, 0x0010008200442211ULL, 0x1210008080021200ULL, 0x0001040830908200ULL,
+	0x0454010840418800ULL, 0xc8c2120124442048ULL, 0x00000a009004a200ULL, 0x0000402214000802ULL,
+	0x1404400109018e04ULL, 0x7091510102012100ULL, 0x09604802084028a8ULL, 0x2030424241000140ULL,
+	0x0000521854400080ULL, 0x0102008208028522ULL, 0x600c05008804a001ULL, 0x000a400084040040ULL,
+	0x421000401041000cULL, 0x0000089001c20000ULL, 0x0484110408008040ULL, 0x0202080604304440ULL,
+	0x2004420051201000ULL, 0x40104a0110880400ULL, 0x080a022026011014ULL, 0x8010400000460800ULL,
+	0x0202000004104406ULL, 0x0080082120421884ULL, 0x00041120424c1040ULL, 0x03a0020082108200ULL,
+};
+#endif
+
+static void initMagics(Magic magics[], Bitboard table[], const int directions[][2], const Bitboard numbers[]){
+	for(int sq = 0; sq < 64; ++sq){
+		Magic &m = magics[sq];
+		m.mask = relevantMask(sq, directions);
+		m.shift = 64 - popCount(m.mask);
+		m.magic = numbers ? numbers[sq] : 0;
+		m.attacks = sq == 0 ? table : magics[sq - 1].attacks + (1 << (64 - magics[sq - 1].shift));
+
+		//every subset of the mask (carry-rippler), subsets sharing an index have the same attacks
+		Bitboard b = 0;
+		do{
+			m.attacks[m.index(b)] = slidingAttacks(sq, b, directions);
+			b = (b - m.mask) & m.mask;
+		} while(b);
+	}
+}
+
+static struct TableInitializer{
+	TableInitializer(){
+#ifdef USE_PEXT
+		initMagics(rookMagics, rookTable, straight, nullptr);
+		initMagics(bishopMagics, bishopTable, diagonal, nullptr);
+#else
+		initMagics(rookMagics, rookTable, straight, rookMagicNumbers);
+		initMagics(bishopMagics, bishopTable, diagonal, bishopMagicNumbers);
+#endif
+	}
+} tableInitializer;
@@ -0,0 +1,99 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include<array>
+#include<cstdint>
+
+typedef uint64_t Bitboard;
+typedef std::array<Bitboard, 64> SquareTable;
+
+//squares are numbered a1 = 0 ... h8 = 63, board coordinates have y = 0 at the black back rank
+inline int toSquare(int x, int y){
+	return x + 8*(7 - y);
+}
+inline int squareX(int sq){
+	return sq & 7;
+}
+inline int squareY(int sq){
+	return 7 - (sq >> 3);
+}
+constexpr Bitboard squareBB(int sq){
+	return 1ULL << sq;
+}
+
+inline int lsb(Bitboard b){
+	return __builtin_ctzll(b);
+}
+inline int popLsb(Bitboard &b){
+	int sq = lsb(b);
+	b &= b - 1;
+	return sq;
+}
+inline int popCount(Bitboard b){
+	return __builtin_popcountll(b);
+}
+
+//sliding piece lookup for one square (index = magic hash or pext of the blockers)
+struct Magic{
+	Bitboard mask;
+	Bitboard magic;
+	Bitboard *attacks;
+	int shift;
+
+	unsigned index(Bitboard occupied) const;
+};
+
+//built at compile time, only the slider tables are filled in at startup (from fixed magics)
+extern const SquareTable knightTable, kingTable, rookRayTable, bishopRayTable;
+extern const std::array<SquareTable, 2> pawnTable;		//pawnTable[0] white, [1] black
+extern const std::array<SquareTable, 64> betweenTable, lineTable;
+extern Magic rookMagics[64], bishopMagics[64];
+
+#ifdef USE_PEXT
+#include<immintrin.h>
+inline unsigned Magic::index(Bitboard occupied) const{
+	return (unsigned)_pext_u64(occupied, mask);
+}
+#else
+inline unsigned Magic::index(Bitboard occupied) const{
+	return (unsigned)(((occupied & mask) * magic) >> shift);
+}
+#endif
+
+inline Bitboard knightAttacks(int sq){
+	return knightTable[sq];
+}
+inline Bitboard kingAttacks(int sq){
+	return kingTable[sq];
+}
+//squares attacked by a pawn of the given color standing on sq
+inline Bitboard pawnAttacks(bool white, int sq){
+	return pawnTable[white ? 0 : 1][sq];
+}
+//what a rook or bishop on sq sees on the empty board
+inline Bitboard rookRays(int sq){
+	return rookRayTable[sq];
+}
+inline Bitboard bishopRays(int sq){
+	return bishopRayTable[sq];
+}
+inline Bitboard rookAttacks(int sq, Bitboard occupied){
+	return rookMagics[sq].attacks[rookMagics[sq].index(occupied)];
+}
+inline Bitboard bishopAttacks(int sq, Bitboard occupied){
+	return bishopMagics[sq].attacks[bishopMagics[sq].index(occupied)];
+}
+inline Bitboard queenAttacks(int sq, Bitboard occupied){
+	return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
+}
+
+//squares strictly between a and b, empty unless they share a rank, file or diagonal
+inline Bitboard betweenBB(int a, int b){
+	return betweenTable[a][b];
+}
+//the whole rank, file or diagonal through a and b, empty if there is none
+inline Bitboard lineBB(int a, int b){
+	return lineTable[a][b];
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include "chess.h"
+
+//polyglot opening book (.bin): 16 byte big endian entries sorted by key
+//the file is mapped read only and searched in place, so opening it costs nothing whatever its size
+//and every process using the same book shares its pages in the page cache
+struct Book{
+	Book() = default;
+	Book(const Book &) = delete;
+	Book &operator=(const Book &) = delete;
+	~Book();
+
+	bool open(const std::string &path);		//false (and closed) if the file can't be mapped
+	void close();
+	bool isOpen() const { return count != 0; }
+
+	//a book move for the side to move, picked at random by weight or the heaviest one, Move() if out of book
+	Move probe(Board &board, bool best = false) const;
+	//all legal book moves with their weights, returns how many
+	int entries(Board &board, Move *moves, int *weights, int max) const;
+
+private:
+	const unsigned char *data = nullptr;
+	size_t count = 0;		//entries
+#ifdef _WIN32
+	void *file = nullptr, *mapping = nullptr;
+#endif
+};
+
+//the position's key in polyglot's zobrist scheme, which is what book entries are sorted by
+uint64_t polyglotKey(Board &board);
+
+#endif
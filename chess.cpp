@@ -1,5 +1,69 @@
 #include "chess.h"
+#include "endgame.h"
+#include "eval.h"
+#include "tt.h"
+#include<algorithm>
+#include<atomic>
+#include<cassert>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<mutex>
+#include<sstream>
+#include<thread>
 #define max(a, b) (a > b ? a : b)
+#define min(a, b) (a < b ? a : b)
+#define MOVE_OVERHEAD 30		//ms kept back from the clock for communication lag
+#define DELTA_MARGIN 200		//centipawns a quiet position may swing by beyond what a capture wins
+#define ASPIRATION_DEPTH 4		//iterations from this one on start with a window around the last score
+#define ASPIRATION_WINDOW 25		//centipawns either side, doubled on every fail
+#define NULL_MOVE_DEPTH 3		//least depth for a null move search
+#define LMR_DEPTH 3				//least depth for late move reductions
+#define LMR_MOVES 4				//moves searched at full depth before reductions start
+
+//move ordering bands of MovePicker, quiet moves are ordered by their history count below SCORE_KILLER
+#define SCORE_HASH (1 << 30)
+#define SCORE_CAPTURE (1 << 24)
+#define SCORE_PROMOTION (1 << 23)
+#define SCORE_KILLER (1 << 22)
+#define HISTORY_MAX (1 << 20)
+
+//search counters, per thread so counting costs no synchronization, and nothing at all unless CHESS_STATS is defined
+#ifdef CHESS_STATS
+static thread_local SearchStats threadStats;
+#define STAT(counter, n) (threadStats.counter += (n))
+#else
+#define STAT(counter, n) ((void)0)
+#endif
+
+struct ZobristKeys{
+	uint64_t piece[13][64];		//indexed like Board::pieces, piece[6] (empty) stays zero
+	uint64_t castle[16];
+	uint64_t black;
+};
+
+constexpr uint64_t nextZobrist(uint64_t &seed){
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return seed * 2685821657736338717ULL;
+}
+
+//generated at compile time so boards constructed during static initialization can hash
+constexpr ZobristKeys makeZobristKeys(){
+	ZobristKeys keys{};
+	uint64_t seed = 0x5DEECE66DULL;
+	for(int p = 0; p < 13; ++p)
+		for(int sq = 0; sq < 64; ++sq)
+			keys.piece[p][sq] = p == empty + 6 ? 0 : nextZobrist(seed);
+	for(int i = 1; i < 16; ++i)
+		keys.castle[i] = nextZobrist(seed);
+	keys.black = nextZobrist(seed);
+	return keys;
+}
+
+constexpr ZobristKeys zobrist = makeZobristKeys();
 
 Coordinate::Coordinate(){
 	clear();
@@ -29,575 +93,1341 @@ Coordinate Board::find(Piece p){
 	}
 	return Coordinate();
 }
+//square of the king of the given color, -1 if it has been captured
+int Board::kingSquare(bool white){
+#ifdef CHESS_KING_SCAN
+	Coordinate c = find(white ? king_w : king_b);
+	return c.isValid() ? toSquare(c.x, c.y) : -1;
+#else
+	return kings[white ? 0 : 1];
+#endif
+}
+Board::Board(){
+	syncBitboards();
+	key = computeKey();
+	psq = computePstSum();
+}
 Piece Board::get(const Coordinate &c){
 	return state[c.x][c.y];
 }
-int Board::getPointSum(){
-	int sum = 0;
+//all writes to state go through here so the bitboards stay in sync
+void Board::set(int x, int y, Piece p){
+	Bitboard b = squareBB(toSquare(x, y));
+	Piece old = state[x][y];
+	pieces[old + 6] ^= b;
+	pieces[p + 6] ^= b;
+	key ^= zobrist.piece[old + 6][toSquare(x, y)] ^ zobrist.piece[p + 6][toSquare(x, y)];
+	psq += pstValue(p, toSquare(x, y)) - pstValue(old, toSquare(x, y));
+	if((old == king_w || old == king_b) && kings[old == king_w ? 0 : 1] == toSquare(x, y))
+		kings[old == king_w ? 0 : 1] = -1;
+	if(p == king_w || p == king_b)
+		kings[p == king_w ? 0 : 1] = toSquare(x, y);
+	if(old > 0)
+		whitePieces ^= b;
+	else if(old < 0)
+		blackPieces ^= b;
+	if(p > 0)
+		whitePieces ^= b;
+	else if(p < 0)
+		blackPieces ^= b;
+	state[x][y] = p;
+}
+Bitboard Board::bitboard(Piece p){
+	return pieces[p + 6];
+}
+Bitboard Board::occupied(){
+	return whitePieces | blackPieces;
+}
+int Board::castleRights(){
+	return castleWL | castleWR << 1 | castleBL << 2 | castleBR << 3;
+}
+void Board::setCastleRights(int rights){
+	castleWL = rights & 1;
+	castleWR = rights & 2;
+	castleBL = rights & 4;
+	castleBR = rights & 8;
+}
+//full hash of the position, set() and the move functions keep key equal to this
+uint64_t Board::computeKey(){
+	uint64_t k = zobrist.castle[castleRights()];
+	for(int x = 0; x < BOARD_SIZE; ++x)
+		for(int y = 0; y < BOARD_SIZE; ++y)
+			k ^= zobrist.piece[state[x][y] + 6][toSquare(x, y)];
+	if(turn == -1)
+		k ^= zobrist.black;
+	return k;
+}
+//rebuilds the bitboards from state
+void Board::syncBitboards(){
+	for(auto &b : pieces)
+		b = 0;
+	whitePieces = blackPieces = 0;
+	kings[0] = kings[1] = -1;
 	for(int x = 0; x < BOARD_SIZE; ++x){
 		for(int y = 0; y < BOARD_SIZE; ++y){
-			switch(state[x][y]){
-			case pawn_b: sum += -1; break;
-			case pawn_w: sum += 1; break;
-			case rook_b: sum += -5; break;
-			case rook_w: sum += 5; break;
-			case knight_b: 
-			case bishop_b: sum += -3; break;
-			case knight_w:
-			case bishop_w: sum += 3; break;
-			case queen_b: sum += -9; break;
-			case queen_w: sum += 9; break;
-			case king_b: sum += -100; break;
-			case king_w: sum += 100; break;
-			}
+			Bitboard b = squareBB(toSquare(x, y));
+			pieces[state[x][y] + 6] |= b;
+			if(state[x][y] > 0)
+				whitePieces |= b;
+			else if(state[x][y] < 0)
+				blackPieces |= b;
+			if(state[x][y] == king_w || state[x][y] == king_b)
+				kings[state[x][y] == king_w ? 0 : 1] = toSquare(x, y);
 		}
 	}
+}
+//piece square sum (white positive), O(1) since set() keeps it up to date
+int Board::getPstSum(){
+#ifdef CHESS_DEBUG
+	assert(psq == computePstSum());
+#endif
+	return psq;
+}
+//full recount of the piece square sum
+int Board::computePstSum(){
+	int sum = 0;
+	for(int x = 0; x < BOARD_SIZE; ++x)
+		for(int y = 0; y < BOARD_SIZE; ++y)
+			sum += pstValue(state[x][y], toSquare(x, y));
 	return sum;
 }
 
+static const char fenLetters[] = "kqbnrp.PRNBQK";		//indexed by Piece + 6
+
+//sets up the position of a FEN record, returns false (leaving the board as it was) if it can't be read
+//en passant isn't supported, so that field is skipped
+bool Board::setFen(const std::string &fen){
+	std::istringstream in(fen);
+	std::string placement, side, castling = "-", en_passant;
+	int halfmove = 0, fullmove = 1;
+	if(!(in >> placement >> side))
+		return false;
+	in >> castling >> en_passant >> halfmove >> fullmove;
+
+	Board b;
+	int x = 0, y = 0;
+	for(char c : placement){
+		if(c == '/'){
+			if(x != BOARD_SIZE || ++y == BOARD_SIZE)
+				return false;
+			x = 0;
+		} else if(c >= '1' && c <= '8'){
+			for(int n = c - '0'; n > 0; --n, ++x){
+				if(x >= BOARD_SIZE)
+					return false;
+				b.state[x][y] = empty;
+			}
+		} else {
+			const char *letter = c != '.' ? strchr(fenLetters, c) : nullptr;
+			if(!letter || x >= BOARD_SIZE)
+				return false;
+			b.state[x++][y] = (Piece)(letter - fenLetters - 6);
+		}
+	}
+	if(x != BOARD_SIZE || y != BOARD_SIZE - 1 || (side != "w" && side != "b"))
+		return false;
+	//positions that can't occur: the search relies on one king a side and no pawns on the back ranks
+	int kings_w = 0, kings_b = 0;
+	for(x = 0; x < BOARD_SIZE; ++x)
+		for(y = 0; y < BOARD_SIZE; ++y){
+			Piece p = b.state[x][y];
+			kings_w += p == king_w;
+			kings_b += p == king_b;
+			if((p == pawn_w || p == pawn_b) && (y == 0 || y == BOARD_SIZE - 1))
+				return false;
+		}
+	if(kings_w != 1 || kings_b != 1)
+		return false;
+
+	b.turn = side == "w" ? 1 : -1;
+	b.halfmoveClock = halfmove;
+	b.fullmoveNumber = fullmove > 0 ? fullmove : 1;
+	b.castleWL = castling.find('Q') != std::string::npos && b.state[4][7] == king_w && b.state[0][7] == rook_w;
+	b.castleWR = castling.find('K') != std::string::npos && b.state[4][7] == king_w && b.state[7][7] == rook_w;
+	b.castleBL = castling.find('q') != std::string::npos && b.state[4][0] == king_b && b.state[0][0] == rook_b;
+	b.castleBR = castling.find('k') != std::string::npos && b.state[4][0] == king_b && b.state[7][0] == rook_b;
+
+	b.syncBitboards();
+	b.key = b.computeKey();
+	b.psq = b.computePstSum();
+	if(isInCheck(b.turn == 1 ? king_b : king_w, b))
+		return false;		//the side to move could take the king
+	Piece own_king = b.turn == 1 ? king_w : king_b;
+	if(isInCheck(own_king, b)){
+		int king_sq = b.kingSquare(own_king == king_w);
+		b.warnedPosition.set(squareX(king_sq), squareY(king_sq));
+	}
+	*this = b;
+	return true;
+}
+
+//the position occurred the given number of times before with the same side to move, looking back to the last
+//capture or pawn move (only as far as the undo stack goes)
+bool Board::isRepeated(int times){
+	int oldest = max(undoSize - halfmoveClock, 0);
+	for(int i = undoSize - 2; i >= oldest; i -= 2){
+		if(undoStack[i].key == key && --times == 0)
+			return true;
+	}
+	return false;
+}
+
+//FEN record of the position, the en passant field is always "-"
+std::string Board::getFen(){
+	std::string fen;
+	for(int y = 0; y < BOARD_SIZE; ++y){
+		int empties = 0;
+		for(int x = 0; x < BOARD_SIZE; ++x){
+			if(state[x][y] == empty){
+				++empties;
+				continue;
+			}
+			if(empties)
+				fen += '0' + empties;
+			empties = 0;
+			fen += fenLetters[state[x][y] + 6];
+		}
+		if(empties)
+			fen += '0' + empties;
+		if(y != BOARD_SIZE - 1)
+			fen += '/';
+	}
+
+	fen += turn == 1 ? " w " : " b ";
+	if(castleWR)
+		fen += 'K';
+	if(castleWL)
+		fen += 'Q';
+	if(castleBR)
+		fen += 'k';
+	if(castleBL)
+		fen += 'q';
+	if(!castleRights())
+		fen += '-';
+	return fen + " - " + std::to_string(halfmoveClock) + " " + std::to_string(fullmoveNumber);
+}
+
+//value of a piece in centipawns, negative for black
+int getPoints(Piece p){
+	static const int points[13] = {-10000, -900, -300, -300, -500, -100, 0, 100, 500, 300, 300, 900, 10000};
+	return points[p + 6];
+}
+
 bool isBlack(Piece p){
 	return p < 0;
 }
 bool isWhite(Piece p){
 	return p > 0;
 }
-bool isSameColor(Piece p1, Piece p2){
-	return (p1 < 0 && p2 < 0) || (p1 > 0 && p2 > 0);
-}
-bool isInBounds(int x, int y){
-	return x >= 0 && x < BOARD_SIZE && y >= 0 && y < BOARD_SIZE;
-}
 bool isEmpty(Board &board, int x, int y){
 	return board.state[x][y] == empty;
 }
 
-void pushToList(CoordinateList &validMoves, Board& board, const Coordinate &from, const Coordinate &to, bool checkIfValid);
-
-//adds valid moves by extrapolating move_increments till a blocking piece is encountered
-void addMoveIncrements(CoordinateList &validMoves, Board &board, const Piece current, const Coordinate &pos, 
-						const Coordinate move_increments[], int move_count, bool checkIfValid){
-	
-	for(int i = 0; i < move_count; ++i){
-		const Coordinate &m = move_increments[i];
-		for(int x = pos.x+m.x, y = pos.y+m.y; isInBounds(x, y); x += m.x, y += m.y){
-			if(isEmpty(board, x, y)){
-				pushToList(validMoves, board, pos, Coordinate(x, y), checkIfValid);
-			} else if(isSameColor(board.state[x][y], current)){
-				break;
-			} else {
-				pushToList(validMoves, board, pos, Coordinate(x, y), checkIfValid);
-				break;
-			}
-		}
-	}
-}
-
 //returns true if the king of checkPiece is in check in the passed board
 bool isInCheck(Piece checkPiece, Board &board){
-	bool (*isOtherColor)(Piece p);
-	int dirCoeff = checkPiece > 0 ? -1 : 1;		//white pieces play up the board
-	Piece check_king = (Piece)(-dirCoeff * king_w);		//pieces are inverse
-	isOtherColor = checkPiece > 0 ? isBlack : isWhite;
+	Piece check_king = isWhite(checkPiece) ? king_w : king_b;
 
-	Coordinate kingPos = board.find(check_king);
-	if(!kingPos.isValid())
+	int king_sq = board.kingSquare(check_king == king_w);
+	if(king_sq < 0)
 		return false;
 
-	//pawn check
-	if((isInBounds(kingPos.x - 1, kingPos.y + dirCoeff) && board.state[kingPos.x - 1][kingPos.y + dirCoeff] == dirCoeff * pawn_w) || 
-		(isInBounds(kingPos.x + 1, kingPos.y + dirCoeff) && board.state[kingPos.x + 1][kingPos.y + dirCoeff] == dirCoeff * pawn_w))
-		return true;
+	return isSquareAttacked(board, king_sq, !isWhite(checkPiece));
+}
 
-	CoordinateList rays;
-	//rook/queen check
-	const Coordinate straight[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-	addMoveIncrements(rays, board, check_king, kingPos, straight, 4, false);
-	for(auto &m : rays){
-		if(board.get(m) == dirCoeff * rook_w || board.get(m) == dirCoeff * queen_w){
-			return true;
-		}
-	}
-	rays.clear();
+//pieces of the given color attacking sq with occupied as the blockers (attack sets are looked up backwards from sq)
+Bitboard attackersOf(Board &board, int sq, bool byWhite, Bitboard occupied){
+	int c = byWhite ? 1 : -1;
+	Bitboard queens = board.bitboard((Piece)(c * queen_w));
 
-	//bishop/queen check
-	const Coordinate diagonal[] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
-	addMoveIncrements(rays, board, check_king, kingPos, diagonal, 4, false);
-	for(auto &m : rays){
-		if(board.get(m) == dirCoeff * bishop_w || board.get(m) == dirCoeff * queen_w){
-			return true;
-		}
-	}
+	return (pawnAttacks(!byWhite, sq) & board.bitboard((Piece)(c * pawn_w)))
+		| (knightAttacks(sq) & board.bitboard((Piece)(c * knight_w)))
+		| (kingAttacks(sq) & board.bitboard((Piece)(c * king_w)))
+		| (bishopAttacks(sq, occupied) & (board.bitboard((Piece)(c * bishop_w)) | queens))
+		| (rookAttacks(sq, occupied) & (board.bitboard((Piece)(c * rook_w)) | queens));
+}
 
-	//knight check
-	const Coordinate L[] = {{-2, 1}, {-2, -1}, {2, 1}, {2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}};
-	for(auto &m : L){
-		int x = kingPos.x + m.x, y = kingPos.y + m.y;
-		if(isInBounds(x, y) && board.state[x][y] == dirCoeff * knight_w)
-			return true;
-	}
+//returns true if any piece of the given color attacks sq
+bool isSquareAttacked(Board &board, int sq, bool byWhite){
+	STAT(check_tests, 1);
+	return attackersOf(board, sq, byWhite, board.occupied()) != 0;
+}
 
-	//king check
-	const Coordinate around[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
-	for(auto &m : around){
-		int x = kingPos.x + m.x, y = kingPos.y + m.y;
-		if(isInBounds(x, y) && board.state[x][y] == -check_king)
-			return true;
-	}
-	return false;
+Piece Move::promotion(int color_coeff) const {
+	static const Piece promoted[4] = {knight_w, bishop_w, rook_w, queen_w};
+	return (Piece)(color_coeff * promoted[flags() & 3]);
 }
 
-//pushes move to first argument (pass checkIfValid=true to avoid illegal moves)
-void pushToList(CoordinateList &validMoves, Board& board, const Coordinate &from, const Coordinate &to, bool checkIfValid){
-	if(!checkIfValid){
-		validMoves.push_back(to);
-		return;
+//index of a promotion piece in the low bits of the move flags, anything else is taken as a queen
+int promotionIndex(Piece p){
+	switch(p){
+		case knight_w: case knight_b: return 0;
+		case bishop_w: case bishop_b: return 1;
+		case rook_w: case rook_b: return 2;
+		default: return 3;
 	}
-	
-	int to_x;
-	if(to.x == INFINITY_NUM)
-		to_x = 6;
-	else if(to.x == -INFINITY_NUM)
-		to_x = 2;
-	else
-		to_x = to.x;
+}
 
-	Piece from_piece = board.get(from), to_piece = board.state[to_x][to.y];
-	board.state[to_x][to.y] = from_piece;
-	board.state[from.x][from.y] = empty;
-	if(!isInCheck(from_piece, board)){
-		
-		validMoves.push_back(to);
+//adds a move of the piece on from to every square in targets
+//moves of a pawn about to promote become four promotions, queen first
+void pushTargets(MoveList &moves, int from, Bitboard targets, Bitboard enemies, bool promotes){
+	static const Piece promotions[4] = {queen_w, knight_w, rook_w, bishop_w};
+	while(targets){
+		int to = popLsb(targets);
+		int flags = squareBB(to) & enemies ? MOVE_CAPTURE : MOVE_QUIET;
+		if(!promotes){
+			moves.push_back(Move(from, to, flags));
+			continue;
+		}
+		for(Piece p : promotions)
+			moves.push_back(Move(from, to, flags | MOVE_PROMOTION | promotionIndex(p)));
 	}
-	board.state[from.x][from.y] = from_piece;
-	board.state[to_x][to.y] = to_piece;
 }
 
-//Fills valid moves into first argument (pass removeInvalid=true to avoid illegal moves)
-void getMoves(CoordinateList &validMoves, const Coordinate &pos, Board &board, bool removeInvalid){
+bool isUnderpromotion(Move m){
+	return m.isPromotion() && (m.flags() & 3) != promotionIndex(queen_w);
+}
+
+bool isPromotingPawn(Piece p, int sq){
+	return (p == pawn_w && squareY(sq) == 1) || (p == pawn_b && squareY(sq) == 6);
+}
 
-	Piece current = board.get(pos);
-	switch(current){
+//squares the piece p on sq can move to, castling aside
+Bitboard pieceTargets(Board &board, int sq, Piece p){
+	Bitboard occupied = board.occupied();
+	Bitboard enemies = isWhite(p) ? board.blackPieces : board.whitePieces;
+	Bitboard targets = ~(isWhite(p) ? board.whitePieces : board.blackPieces);
+	int y = squareY(sq);
+
+	switch(p){
 		case pawn_b:{
 			//pawn cant be at y = 7 [since promotion], so no need to check if in bounds
-			if(isEmpty(board, pos.x, pos.y + 1)){
-				pushToList(validMoves, board, pos, Coordinate(pos.x, pos.y + 1), removeInvalid);
-				if(pos.y == 1 && isEmpty(board, pos.x, 3))		//double move at beginning
-					pushToList(validMoves, board, pos, Coordinate(pos.x, 3), removeInvalid);
-			}
+			Bitboard push = squareBB(sq - 8) & ~occupied;
+			if(push && y == 1)		//double move at beginning
+				push |= squareBB(sq - 16) & ~occupied;
 			//cut
-			if(isInBounds(pos.x - 1, pos.y + 1) && isWhite(board.state[pos.x - 1][pos.y + 1]))
-				pushToList(validMoves, board, pos, Coordinate(pos.x - 1, pos.y + 1), removeInvalid);
-			if(isInBounds(pos.x + 1, pos.y + 1) && isWhite(board.state[pos.x + 1][pos.y + 1]))
-				pushToList(validMoves, board, pos, Coordinate(pos.x + 1, pos.y + 1), removeInvalid);
-			break;
+			return push | (pawnAttacks(false, sq) & enemies);
 		}
 
 		case pawn_w:{
-			if(isEmpty(board, pos.x, pos.y - 1)){
-				pushToList(validMoves, board, pos, Coordinate(pos.x, pos.y - 1), removeInvalid);
-				if(pos.y == 6 && isEmpty(board, pos.x, 4))
-					pushToList(validMoves, board, pos, Coordinate(pos.x, 4), removeInvalid);
-			}
-
-			if(isInBounds(pos.x - 1, pos.y - 1) && isBlack(board.state[pos.x - 1][pos.y - 1]))
-				pushToList(validMoves, board, pos, Coordinate(pos.x - 1, pos.y - 1), removeInvalid);
-			if(isInBounds(pos.x + 1, pos.y - 1) && isBlack(board.state[pos.x + 1][pos.y - 1]))
-				pushToList(validMoves, board, pos, Coordinate(pos.x + 1, pos.y - 1), removeInvalid);
-			break;
+			Bitboard push = squareBB(sq + 8) & ~occupied;
+			if(push && y == 6)
+				push |= squareBB(sq + 16) & ~occupied;
+			return push | (pawnAttacks(true, sq) & enemies);
 		}
 
 		case rook_b:
-		case rook_w:{
-			const Coordinate move_increments[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-			addMoveIncrements(validMoves, board, current, pos, move_increments, 4, removeInvalid);
-			break;
-		}
+		case rook_w:
+			return targets & rookAttacks(sq, occupied);
 	
 		case knight_b:
-		case knight_w:{	
-			const Coordinate moveIncrements[] = {{-2, 1}, {-2, -1}, {2, 1}, {2, -1}, 
-					{1, 2}, {1, -2}, {-1, 2}, {-1, -2}};
-			//movement list
-			for(const Coordinate& c: moveIncrements){
-				int x = pos.x + c.x, y = pos.y + c.y;
-				if(isInBounds(x, y) && (isEmpty(board, x, y) || !isSameColor(board.state[x][y],current)))
-					pushToList(validMoves, board, pos, Coordinate(x, y), removeInvalid);
-			}
-			break;
-		}
+		case knight_w:
+			return targets & knightAttacks(sq);
 
 		case bishop_b:
-		case bishop_w:{
-			const Coordinate move_increments[] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
-			addMoveIncrements(validMoves, board, current, pos, move_increments, 4, removeInvalid);
-			break;
-		}
+		case bishop_w:
+			return targets & bishopAttacks(sq, occupied);
 	
 		case queen_b:
-		case queen_w:{
-			const Coordinate move_increments[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
-			addMoveIncrements(validMoves, board, current, pos, move_increments, 8, removeInvalid);
-			break;
-		}
+		case queen_w:
+			return targets & queenAttacks(sq, occupied);
 	
-		case king_b:{
-			//castle
-			if(board.castleBL && isEmpty(board, 1, 0) && isEmpty(board, 2, 0) && isEmpty(board, 3, 0) && board.get(board.warnedPosition) != king_b)
-				pushToList(validMoves, board, pos, Coordinate(-INFINITY_NUM, 0), removeInvalid);
-			if(board.castleBR && isEmpty(board, 5, 0) && isEmpty(board, 6, 0) && board.get(board.warnedPosition) != king_b)
-				pushToList(validMoves, board, pos, Coordinate(INFINITY_NUM, 0), removeInvalid);
-
-			const Coordinate move_increments[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
-			for(auto &m: move_increments){
-				int x = pos.x + m.x, y = pos.y + m.y;
-				if(isInBounds(x, y) && (isEmpty(board, x, y) || !isSameColor(current, board.state[x][y])))
-					pushToList(validMoves, board, pos, Coordinate(x, y), removeInvalid);
-			}
-			break;
+		case king_b:
+		case king_w:
+			return targets & kingAttacks(sq);
+
+		default:
+			return 0;
+	}
+}
+
+//castles of the given color's king, with checkAttacks the squares the king crosses and lands on must not be attacked
+//(the caller makes sure the king isn't in check)
+void pushCastles(MoveList &moves, Board &board, bool white, bool checkAttacks){
+	int y = white ? 7 : 0, from = toSquare(4, y);
+	bool queen_side = white ? board.castleWL : board.castleBL, king_side = white ? board.castleWR : board.castleBR;
+
+	if(queen_side && isEmpty(board, 1, y) && isEmpty(board, 2, y) && isEmpty(board, 3, y)
+			&& !(checkAttacks && (isSquareAttacked(board, toSquare(3, y), !white) || isSquareAttacked(board, toSquare(2, y), !white))))
+		moves.push_back(Move(from, toSquare(2, y), MOVE_CASTLE_QUEEN));
+	if(king_side && isEmpty(board, 5, y) && isEmpty(board, 6, y)
+			&& !(checkAttacks && (isSquareAttacked(board, toSquare(5, y), !white) || isSquareAttacked(board, toSquare(6, y), !white))))
+		moves.push_back(Move(from, toSquare(6, y), MOVE_CASTLE_KING));
+}
+
+//pseudo-legal moves of the piece on sq, for its own color whoever is to move
+void generatePieceMoves(Board &board, int sq, MoveList &moves){
+	Piece current = board.state[squareX(sq)][squareY(sq)];
+	Bitboard enemies = isWhite(current) ? board.blackPieces : board.whitePieces;
+
+	pushTargets(moves, sq, pieceTargets(board, sq, current), enemies, isPromotingPawn(current, sq));
+	if(current == king_w || current == king_b)
+		pushCastles(moves, board, current == king_w, false);
+}
+
+//legal moves of the pieces of one color in from_mask: checkers and pinned pieces are worked out once,
+//then only evasions, moves along the pin ray and king moves onto unattacked squares are generated
+//noisy keeps just the captures and promotions
+void generateLegal(Board &board, bool white, Bitboard from_mask, MoveList &moves, bool noisy){
+	STAT(generations, 1);
+	int c = white ? 1 : -1;
+	Bitboard own = white ? board.whitePieces : board.blackPieces;
+	Bitboard enemies = white ? board.blackPieces : board.whitePieces;
+	Bitboard occupied = own | enemies;
+
+	int king = board.kingSquare(white);
+	if(king < 0){		//no king to keep safe
+		Bitboard pieces = own & from_mask;
+		while(pieces)
+			generatePieceMoves(board, popLsb(pieces), moves);
+		return;
+	}
+
+	Bitboard checkers = attackersOf(board, king, !white, occupied);
+
+	//an own piece alone between the king and an enemy slider is pinned
+	Bitboard queens = board.bitboard((Piece)(-c * queen_w));
+	Bitboard snipers = (rookRays(king) & (board.bitboard((Piece)(-c * rook_w)) | queens))
+					| (bishopRays(king) & (board.bitboard((Piece)(-c * bishop_w)) | queens));
+	Bitboard pinned = 0;
+	while(snipers){
+		Bitboard blockers = betweenBB(king, popLsb(snipers)) & occupied;
+		if(blockers && !(blockers & (blockers - 1)) && (blockers & own))
+			pinned |= blockers;
+	}
+
+	if(from_mask & squareBB(king)){
+		//the king is taken off the board so it can't hide behind itself from a slider
+		Bitboard targets = kingAttacks(king) & (noisy ? enemies : ~own), without_king = occupied ^ squareBB(king), safe = 0;
+		while(targets){
+			int to = popLsb(targets);
+			if(!attackersOf(board, to, !white, without_king))
+				safe |= squareBB(to);
+		}
+		pushTargets(moves, king, safe, enemies, false);
+		if(!checkers && !noisy)
+			pushCastles(moves, board, white, true);
+	}
+
+	//in double check only the king can move
+	if(checkers & (checkers - 1))
+		return;
+
+	//a single check has to be captured or blocked
+	Bitboard allowed = checkers ? checkers | betweenBB(king, lsb(checkers)) : ~0ULL;
+
+	Bitboard pieces = own & from_mask & ~squareBB(king);
+	while(pieces){
+		int from = popLsb(pieces);
+		Piece p = board.state[squareX(from)][squareY(from)];
+		bool promotes = isPromotingPawn(p, from);
+		Bitboard targets = pieceTargets(board, from, p) & allowed;
+		if(noisy && !promotes)
+			targets &= enemies;
+		if(pinned & squareBB(from))
+			targets &= lineBB(king, from);
+		pushTargets(moves, from, targets, enemies, promotes);
+	}
+}
+
+//legal moves of the side to move
+void generateLegalMoves(Board &board, MoveList &moves){
+	generateLegal(board, board.turn == 1, ~0ULL, moves);
+}
+
+//coordinate notation (e2e4, e7e8q), castling is written as the king move
+std::string moveToString(Move m){
+	std::string s;
+	s += 'a' + (m.from() & 7);
+	s += '1' + (m.from() >> 3);
+	s += 'a' + (m.to() & 7);
+	s += '1' + (m.to() >> 3);
+	if(m.isPromotion())
+		s += "nbrq"[m.flags() & 3];
+	return s;
+}
+
+//the legal move written as s in coordinate notation, Move() if there is none
+Move parseMove(Board &board, const std::string &s){
+	MoveList moves;
+	generateLegalMoves(board, moves);
+	for(Move m : moves){
+		//a promotion without a piece letter is taken as a queen
+		if(moveToString(m) == s || (m.isPromotion() && (m.flags() & 3) == promotionIndex(queen_w) && moveToString(m) == s + 'q'))
+			return m;
+	}
+	return Move();
+}
+
+//reads "startpos | fen <fen> [moves <move>...]" (the rest of a position command) into board,
+//false with the reason in error (board untouched) if the position or a move is bad
+bool setPosition(Board &board, std::istream &in, std::string &error){
+	std::string token, fen;
+	Board b;
+	in >> token;
+	if(token == "startpos"){
+		in >> token;
+	} else if(token == "fen"){
+		while(in >> token && token != "moves")
+			fen += token + " ";
+		if(!b.setFen(fen)){
+			error = "invalid fen " + fen;
+			return false;
 		}
-		case king_w:{
-			if(board.castleWL && isEmpty(board, 1, 7) && isEmpty(board, 2, 7) && isEmpty(board, 3, 7) && board.get(board.warnedPosition) != king_w)
-				pushToList(validMoves, board, pos, Coordinate(-INFINITY_NUM, 7), removeInvalid);
-			if(board.castleWR && isEmpty(board, 5, 7) && isEmpty(board, 6, 7) && board.get(board.warnedPosition) != king_w)
-				pushToList(validMoves, board, pos, Coordinate(INFINITY_NUM, 7), removeInvalid);
-
-			const Coordinate move_increments[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
-			for(auto &m: move_increments){
-				int x = pos.x + m.x, y = pos.y + m.y;
-				if(isInBounds(x, y) && (isEmpty(board, x, y) || !isSameColor(current, board.state[x][y])))
-					pushToList(validMoves, board, pos, Coordinate(x, y), removeInvalid);
+	} else {
+		error = "expected startpos or fen";
+		return false;
+	}
+
+	if(token == "moves"){
+		while(in >> token){
+			Move m = parseMove(b, token);
+			if(m == Move()){
+				error = "illegal move " + token;
+				return false;
 			}
-			break;
+			playMove(b, m);
 		}
 	}
+	board = b;
+	return true;
 }
 
-Piece handlePromotionChoice(const Coordinate &c, Board &board, int depth, CoordinateList& white, CoordinateList& black);
+//destination in the coordinates the gui uses: castling is x = +-INFINITY_NUM on the king's rank
+Coordinate toCoordinate(Move m){
+	int x = squareX(m.to()), y = squareY(m.to());
+	if(m.flags() == MOVE_CASTLE_KING)
+		x = INFINITY_NUM;
+	else if(m.flags() == MOVE_CASTLE_QUEEN)
+		x = -INFINITY_NUM;
+	return Coordinate(x, y);
+}
+
+//Fills valid moves into first argument (pass removeInvalid=true to avoid illegal moves)
+void getMoves(CoordinateList &validMoves, const Coordinate &pos, Board &board, bool removeInvalid){
+	int sq = toSquare(pos.x, pos.y);
+	MoveList moves;
+	if(removeInvalid)
+		generateLegal(board, isWhite(board.get(pos)), squareBB(sq), moves);
+	else
+		generatePieceMoves(board, sq, moves);
+	//the gui asks for the piece when a promotion is played, one square per promotion is enough
+	for(Move m : moves){
+		if(!isUnderpromotion(m))
+			validMoves.push_back(toCoordinate(m));
+	}
+}
+
+//castle rights left after a move from or to sq (a rook or king leaving its square, or a rook being taken)
+int castleMask(int sq){
+	switch(sq){
+		case 0: return ~1;			//a1
+		case 4: return ~3;			//e1
+		case 7: return ~2;			//h1
+		case 56: return ~4;			//a8
+		case 60: return ~12;		//e8
+		case 63: return ~8;			//h8
+	}
+	return ~0;
+}
+
+//plays m for the piece on its from square and pushes what is needed to take it back
+void Board::makeMove(Move m){
+	STAT(moves_made, 1);
+	UndoInfo &undo = undoStack[undoSize++];
+	int from = m.from(), to = m.to();
+	int from_x = squareX(from), from_y = squareY(from), to_x = squareX(to), to_y = squareY(to);
+	Piece moving = state[from_x][from_y];
+
+	undo.move = m;
+	undo.captured = state[to_x][to_y];
+	undo.castleRights = castleRights();
+	undo.warnedPosition = warnedPosition;
+	undo.key = key;
+	undo.halfmoveClock = halfmoveClock;
+
+	halfmoveClock = (moving == pawn_w || moving == pawn_b || m.isCapture()) ? 0 : halfmoveClock + 1;
+	if(turn == -1)
+		++fullmoveNumber;
+
+	int rights = undo.castleRights & castleMask(from) & castleMask(to);
+	if(rights != undo.castleRights){
+		setCastleRights(rights);
+		key ^= zobrist.castle[undo.castleRights] ^ zobrist.castle[rights];
+	}
+
+	if(m.isCastle()){
+		int rook_from = m.flags() == MOVE_CASTLE_KING ? 7 : 0, rook_to = m.flags() == MOVE_CASTLE_KING ? 5 : 3;
+		set(to_x, to_y, moving);
+		set(rook_to, to_y, state[rook_from][to_y]);
+		set(from_x, from_y, empty);
+		set(rook_from, to_y, empty);
+
+	} else {
+		set(to_x, to_y, m.isPromotion() ? m.promotion(isWhite(moving) ? 1 : -1) : moving);
+		set(from_x, from_y, empty);
+	}
+	turn = -turn;
+	key ^= zobrist.black;
+}
+
+//takes back the last makeMove
+void Board::unmakeMove(){
+	UndoInfo &undo = undoStack[--undoSize];
+	Move m = undo.move;
+	int from_x = squareX(m.from()), from_y = squareY(m.from()), to_x = squareX(m.to()), to_y = squareY(m.to());
+
+	if(m.isCastle()){
+		int rook_from = m.flags() == MOVE_CASTLE_KING ? 7 : 0, rook_to = m.flags() == MOVE_CASTLE_KING ? 5 : 3;
+		set(from_x, from_y, state[to_x][to_y]);
+		set(rook_from, to_y, state[rook_to][to_y]);
+		set(to_x, to_y, empty);
+		set(rook_to, to_y, empty);
+
+	} else {
+		Piece moved = state[to_x][to_y];
+		if(m.isPromotion())
+			moved = isWhite(moved) ? pawn_w : pawn_b;
+		set(from_x, from_y, moved);
+		set(to_x, to_y, undo.captured);
+	}
+
+	setCastleRights(undo.castleRights);
+	warnedPosition = undo.warnedPosition;
+	turn = -turn;
+	key = undo.key;
+	halfmoveClock = undo.halfmoveClock;
+	if(turn == -1)
+		--fullmoveNumber;
+}
+
+void Board::makeNullMove(){
+	UndoInfo &undo = undoStack[undoSize++];
+	undo.move = Move();
+	undo.captured = empty;
+	undo.castleRights = castleRights();
+	undo.warnedPosition = warnedPosition;
+	undo.key = key;
+	undo.halfmoveClock = halfmoveClock;
+	++halfmoveClock;
+	if(turn == -1)
+		++fullmoveNumber;
+	turn = -turn;
+	key ^= zobrist.black;
+}
+
+void Board::unmakeNullMove(){
+	UndoInfo &undo = undoStack[--undoSize];
+	turn = -turn;
+	key = undo.key;
+	halfmoveClock = undo.halfmoveClock;
+	if(turn == -1)
+		--fullmoveNumber;
+}
 
 //Moves piece from one position to another
 void movePiece(Board &board, const Coordinate &from, const Coordinate &to, Piece (*getPromotionChoice)()){
-	//castling updates
-	if(board.castleWL && ((from.x == 0 && from.y == 7) || (to.x == 0 && to.y == 7)))
-		board.castleWL = false;
-	if(board.castleWR && ((from.x == 7 && from.y == 7) || (to.x == 7 && to.y == 7)))
-		board.castleWR = false;
-	if(board.castleBL && ((from.x == 0 && from.y == 0) || (to.x == 0 && to.y == 0)))
-		board.castleBL = false;
-	if(board.castleBR && ((from.x == 7 && from.y == 0) || (to.x == 7 && to.y == 0)))
-		board.castleBR = false;
-	if((board.castleWL || board.castleWR) && board.get(from) == king_w)
-		board.castleWL = board.castleWR = false;
-	if((board.castleBL || board.castleBR) && board.get(from) == king_b)
-		board.castleBL = board.castleBR = false;
-
+	int from_sq = toSquare(from.x, from.y);
+	Move m;
 	if(to.x == INFINITY_NUM){
-		board.state[6][to.y] = board.get(from);
-		board.state[5][to.y] = board.state[7][to.y];
-		board.state[from.x][from.y] = board.state[7][to.y] = empty;
-
+		m = Move(from_sq, toSquare(6, to.y), MOVE_CASTLE_KING);
 	} else if(to.x == -INFINITY_NUM){
-		board.state[2][to.y] = board.get(from);
-		board.state[3][to.y] = board.state[0][to.y];
-		board.state[from.x][from.y] = board.state[0][to.y] = empty;
+		m = Move(from_sq, toSquare(2, to.y), MOVE_CASTLE_QUEEN);
+	} else {
+		Piece p = board.get(from);
+		int flags = board.get(to) != empty ? MOVE_CAPTURE : MOVE_QUIET;
+		//promotion
+		if((p == pawn_b && to.y == 7) || (p == pawn_w && to.y == 0))
+			flags |= MOVE_PROMOTION | promotionIndex(getPromotionChoice());
+		m = Move(from_sq, toSquare(to.x, to.y), flags);
+	}
+	playMove(board, m);
+}
 
-	} else{
-		board.state[to.x][to.y] = board.get(from);
-		board.state[from.x][from.y] = empty;
+//plays a move of the game (as opposed to one inside a search) and marks a king it puts in check
+void playMove(Board &board, Move m){
+	//a game can outlast the undo stack, keep the newer half (and room for a search on top)
+	if(board.undoSize >= MAX_HISTORY - MAX_PLY){
+		int keep = board.undoSize / 2;
+		std::copy(board.undoStack + board.undoSize - keep, board.undoStack + board.undoSize, board.undoStack);
+		board.undoSize = keep;
+	}
+	Piece check_king = isWhite(board.state[squareX(m.from())][squareY(m.from())]) ? king_b : king_w;
+	board.makeMove(m);
 
-		//promotion
-		if((board.get(to) == pawn_b && to.y == 7) || (board.get(to) == pawn_w && to.y == 0))
-			board.state[to.x][to.y] = getPromotionChoice();
-		
-		Piece check_king = isWhite(board.get(to))?king_b:king_w;
-		if(isInCheck(check_king, board)){
-			Coordinate kingPos(board.find(check_king));
-			board.warnedPosition.set(kingPos.x, kingPos.y);
-		} else {
-			board.warnedPosition.clear();
+	//marks the king the move put in check
+	if(isInCheck(check_king, board)){
+		int king_sq = board.kingSquare(check_king == king_w);
+		board.warnedPosition.set(squareX(king_sq), squareY(king_sq));
+	} else {
+		board.warnedPosition.clear();
+	}
+}
+
+//budget and stop flag shared by every thread of one search
+struct SearchShared{
+	std::atomic<bool> stop{false};
+	std::atomic<long long> nodes{0};
+	std::atomic<long long> cutoffs{0}, first_cutoffs{0};
+	const std::atomic<bool> *external_stop = nullptr;		//SearchLimits::stop
+	const std::atomic<bool> *ponder = nullptr;				//SearchLimits::ponder
+	long long node_limit = 0;
+	TranspositionTable *tt = nullptr;		//SearchLimits::tt, or the global table
+	Clock::time_point start, deadline;
+	bool timed = false;
+
+	std::mutex stats_mutex;		//threads add their counters to stats when they finish
+	SearchStats stats = {};
+};
+
+//state of one search thread
+struct SearchContext{
+	SearchShared *shared;
+	const SearchLimits *limits;
+	bool main_thread;
+	long long nodes = 0, reported = 0;		//reported: part of nodes already added to shared->nodes
+	long long cutoffs = 0, first_cutoffs = 0;	//beta cutoffs in negamax, and how many the first move searched caused
+	bool stopped = false;
+	int iteration = 0, ply = 0;
+
+	//triangular principal variation table, and the line of the last finished iteration
+	Move pv[MAX_PLY + 1][MAX_PLY + 1];
+	int pv_length[MAX_PLY + 1];
+	Move prev_pv[MAX_PLY + 1];
+	int prev_pv_length = 0;
+	bool follow_pv = false;
+
+	MoveList moves[MAX_PLY + 1];		//move buffer of each ply, so the search itself never allocates
+
+	//quiet moves that caused cutoffs: the last two per ply, and a count per side, from and to square
+	Move killers[MAX_PLY + 1][2] = {};
+	int history[2][64][64] = {};
+};
+
+//stops the search once the node or time budget is used up (the main thread always finishes its first iteration)
+//the time limits apply, pondering holds them off
+static bool clockRunning(const SearchShared &shared){
+	return shared.timed && !(shared.ponder && shared.ponder->load(std::memory_order_relaxed));
+}
+
+bool outOfBudget(SearchContext &ctx){
+	SearchShared &shared = *ctx.shared;
+	if((ctx.nodes & 1023) == 0){
+		long long total = shared.nodes += ctx.nodes - ctx.reported;
+		ctx.reported = ctx.nodes;
+		if((shared.node_limit && total >= shared.node_limit) || (clockRunning(shared) && Clock::now() >= shared.deadline))
+			shared.stop = true;
+	}
+	if(shared.external_stop && shared.external_stop->load(std::memory_order_relaxed))
+		shared.stop.store(true, std::memory_order_relaxed);
+	if(shared.stop.load(std::memory_order_relaxed) && !(ctx.main_thread && ctx.iteration == 1))
+		ctx.stopped = true;
+	return ctx.stopped;
+}
+
+//mate scores go into the hash table as distance from the node instead of from the root
+int scoreToTT(int score, int ply){
+	return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;
+}
+int scoreFromTT(int score, int ply){
+	return score >= MATE_BOUND ? score - ply : score <= -MATE_BOUND ? score + ply : score;
+}
+
+//makes move the first of the current ply's line, followed by the line of the reply
+void updatePv(SearchContext &ctx, Move move){
+	int ply = ctx.ply;
+	ctx.pv[ply][ply] = move;
+	for(int i = ply + 1; i < ctx.pv_length[ply + 1]; ++i)
+		ctx.pv[ply][i] = ctx.pv[ply + 1][i];
+	ctx.pv_length[ply] = ctx.pv_length[ply + 1];
+}
+
+//material a capture or promotion wins, in centipawns
+int materialGain(Board &board, Move m){
+	int gain = m.isCapture() ? getPoints(board.state[squareX(m.to())][squareY(m.to())]) : 0;
+	if(gain < 0)
+		gain = -gain;
+	if(m.isPromotion())
+		gain += getPoints(m.promotion(1)) - getPoints(pawn_w);
+	return gain;
+}
+
+//hands out the moves of a node best first: hash move, captures by MVV-LVA, promotions, killers, quiet moves by history,
+//then underpromotions, which are hardly ever better than the queen
+//every move is scored once up front, next() then selects the best one left, so a cutoff early on saves sorting the rest
+struct MovePicker{
+	MoveList &moves;
+	int scores[MAX_MOVES];
+	int current = 0;
+	bool found_hash = false;		//the hash move was one of the moves
+
+	MovePicker(Board &board, MoveList &moves, Move hash_move, SearchContext &ctx) : moves(moves){
+		Move *killers = ctx.killers[ctx.ply];
+		int (*history)[64] = ctx.history[board.turn == 1 ? 0 : 1];
+		for(int i = 0; i < moves.size(); ++i){
+			Move m = moves[i];
+			if(m == hash_move){
+				scores[i] = SCORE_HASH;
+				found_hash = true;
+			} else if(isUnderpromotion(m)){
+				scores[i] = -1;
+			} else if(m.isCapture()){
+				//most valuable victim first, and the cheapest attacker first among equal victims
+				scores[i] = SCORE_CAPTURE + materialGain(board, m) * 256 - abs(getPoints(board.state[squareX(m.from())][squareY(m.from())]));
+			} else if(m.isPromotion()){
+				scores[i] = SCORE_PROMOTION;
+			} else if(m == killers[0]){
+				scores[i] = SCORE_KILLER + 1;
+			} else if(m == killers[1]){
+				scores[i] = SCORE_KILLER;
+			} else {
+				scores[i] = history[m.from()][m.to()];
+			}
 		}
 	}
+
+	bool next(Move &m){
+		if(current == moves.size())
+			return false;
+		int best = current;
+		for(int i = current + 1; i < moves.size(); ++i){
+			if(scores[i] > scores[best])
+				best = i;
+		}
+		std::swap(moves[current], moves[best]);
+		std::swap(scores[current], scores[best]);
+		m = moves[current++];
+		return true;
+	}
+};
+
+//a quiet move that caused a cutoff becomes a killer of its ply and gains history, deeper cutoffs gain more
+void updateQuietStats(SearchContext &ctx, int turn, Move m, int depth){
+	Move *killers = ctx.killers[ctx.ply];
+	if(killers[0] != m){
+		killers[1] = killers[0];
+		killers[0] = m;
+	}
+
+	int (*history)[64] = ctx.history[turn == 1 ? 0 : 1];
+	history[m.from()][m.to()] += depth * depth;
+	if(history[m.from()][m.to()] >= HISTORY_MAX){		//keeps history below the killers, older counts fade
+		for(int from = 0; from < 64; ++from)
+			for(int to = 0; to < 64; ++to)
+				history[from][to] /= 2;
+	}
 }
 
-void movePieceCalcPromotion(Board &board, const Coordinate &from, const Coordinate &to, int promotion_depth, CoordinateList &white, CoordinateList &black){
-	if(board.castleWL && ((from.x == 0 && from.y == 7) || (to.x == 0 && to.y == 7)))
-		board.castleWL = false;
-	if(board.castleWR && ((from.x == 7 && from.y == 7) || (to.x == 7 && to.y == 7)))
-		board.castleWR = false;
-	if(board.castleBL && ((from.x == 0 && from.y == 0) || (to.x == 0 && to.y == 0)))
-		board.castleBL = false;
-	if(board.castleBR && ((from.x == 7 && from.y == 0) || (to.x == 7 && to.y == 0)))
-		board.castleBR = false;
-	if((board.castleWL || board.castleWR) && board.get(from) == king_w)
-		board.castleWL = board.castleWR = false;
-	if((board.castleBL || board.castleBR) && board.get(from) == king_b)
-		board.castleBL = board.castleBR = false;
+//searches captures and promotions only till the position is quiet, so the horizon doesn't split an exchange
+//the side to move may stand pat on the current score unless it is in check, then every evasion is searched
+int quiesce(Board &board, int alpha, int beta, int color_coeff, SearchContext &ctx){
+	ctx.pv_length[ctx.ply] = ctx.ply;
+	++ctx.nodes;
+	if(outOfBudget(ctx))
+		return 0;
 
-	if(to.x == INFINITY_NUM){
-		board.state[6][to.y] = board.get(from);
-		board.state[5][to.y] = board.state[7][to.y];
-		board.state[from.x][from.y] = board.state[7][to.y] = empty;
+	STAT(qnodes, 1);
+	int table_score;
+	if(probeEndgame(board, ctx.ply, table_score)){
+		STAT(endgame_hits, 1);
+		return table_score;
+	}
 
-	} else if(to.x == -INFINITY_NUM){
-		board.state[2][to.y] = board.get(from);
-		board.state[3][to.y] = board.state[0][to.y];
-		board.state[from.x][from.y] = board.state[0][to.y] = empty;
+	int stand_pat = color_coeff * evaluate(board);
+	if(ctx.ply >= MAX_PLY)
+		return stand_pat;
 
-	} else{
-		board.state[to.x][to.y] = board.get(from);
-		board.state[from.x][from.y] = empty;
-		//promotion
-		if((board.get(to) == pawn_b && to.y == 7) || (board.get(to) == pawn_w && to.y == 0))
-			board.state[to.x][to.y] = handlePromotionChoice(to, board, promotion_depth, white, black);
+	bool in_check = isInCheck(board.turn == 1 ? king_w : king_b, board);
+	MoveList &moves = ctx.moves[ctx.ply];
+	moves.clear();
+	generateLegal(board, board.turn == 1, ~0ULL, moves, !in_check);
+	STAT(generated, moves.size());
 
-		Piece check_king = isWhite(board.get(to))?king_b:king_w;
-		if(isInCheck(check_king, board)){
-			Coordinate kingPos(board.find(check_king));
-			board.warnedPosition.set(kingPos.x, kingPos.y);
-		} else {
-			board.warnedPosition.clear();
+	int max_val = stand_pat;
+	if(in_check){
+		if(moves.empty())
+			return -MATE_SCORE + ctx.ply;
+		max_val = -INFINITY_NUM;
+	} else {
+		if(stand_pat >= beta)
+			return stand_pat;
+		alpha = max(alpha, stand_pat);
+	}
+
+	MovePicker picker(board, moves, Move(), ctx);
+	for(Move m; picker.next(m); ){
+		//delta pruning: a capture that can't lift the score to alpha even with the margin isn't worth a look
+		//underpromotions are left to the full search
+		if(!in_check && (stand_pat + materialGain(board, m) + DELTA_MARGIN <= alpha || isUnderpromotion(m)))
+			continue;
+
+		board.makeMove(m);
+		++ctx.ply;
+		int val = -quiesce(board, -beta, -alpha, -color_coeff, ctx);
+		--ctx.ply;
+		board.unmakeMove();
+		if(ctx.stopped)
+			return 0;
+
+		if(val > max_val)
+			max_val = val;
+		if(val > alpha){
+			alpha = val;
+			updatePv(ctx, m);
 		}
+		if(beta <= alpha)
+			break;
 	}
+	return max_val;
 }
 
-bool isCapture( Board &board, const Coordinate &move, int color_coeff) {
-    Piece targetPiece = board.get(move);
-    return targetPiece != empty && ((color_coeff == 1 && isBlack(targetPiece)) || (color_coeff == -1 && isWhite(targetPiece)));
-}
-
-void orderMovesByCapture(Board &board, CoordinateList &moves, int color_coeff) {
-    // Separate the moves into captures and non-captures
-    CoordinateList captures, nonCaptures;
-    
-    for (auto &move : moves) {
-        if (isCapture(board, move, color_coeff)) {
-            captures.push_back(move);  // Move is a capture
-        } else {
-            nonCaptures.push_back(move);  // Move is not a capture
-        }
-    }
-
-    // First add all capture moves (to the front)
-    moves = captures;
-    // Then add the non-capture moves
-    moves.insert(moves.end(), nonCaptures.begin(), nonCaptures.end());
-}
-
-
-bool isGameOver(Board &board){
-	return !(board.find(king_w).isValid() && board.find(king_b).isValid());
-}
-
-int negamax(Board &board, int depth, int alpha, int beta, int color_coeff, CoordinateList &white, CoordinateList &black){
-	if(depth == 0 || isGameOver(board))
-		return color_coeff * board.getPointSum();
-
-	CoordinateList &pieces = color_coeff == -1? black:white;
-	bool (*isColor)(Piece) = color_coeff == -1? isBlack:isWhite;
-
-	int max_val = -INFINITY_NUM;
-	for(auto &p : pieces){
-		if(isColor(board.get(p))){	//recursive calls dont remove cut pieces
-			CoordinateList moves;
-			getMoves(moves, p, board, false);
-			orderMovesByCapture(board,moves,color_coeff);
-			for(auto &m : moves){
-				//make backup
-				Piece from_piece = board.get(p), 
-					to_piece = (m.x != INFINITY_NUM && m.x != -INFINITY_NUM) ? board.get(m) : empty;
-				Coordinate warnedPosition(board.warnedPosition);
-				bool castleBL = board.castleBL, castleBR = board.castleBR, castleWL = board.castleWL, castleWR = board.castleWR;
-				
-				movePieceCalcPromotion(board, p, m, depth, white, black);
-
-				int p_x = p.x, p_y = p.y;
-				Coordinate *castle_rook = nullptr;
-				if(m.x == INFINITY_NUM){
-					p.x = 6;
-					for(auto &pos: pieces){
-						if(pos.x == 7 && pos.y == p.y){
-							pos.x = 5;
-							castle_rook = &pos;
-							break;
-						}
-					}
-				} else if(m.x == -INFINITY_NUM){
-					p.x = 2;
-					for(auto &pos: pieces){
-						if(pos.x == 0 && pos.y == p.y){
-							pos.x = 3;
-							castle_rook = &pos;
-							break;
-						}
-					}
-				} else {
-					p.set(m.x, m.y);
-				}
-				
-				int val = -negamax(board, depth - 1, -beta, -alpha, -color_coeff, white, black);
-				
-				//restore backup
-				if(m.x == INFINITY_NUM){
-					p.x = 4;
-					castle_rook->x = 7;
-
-					board.state[4][p.y] = color_coeff==1? king_w:king_b;
-					board.state[5][p.y] = empty;
-					board.state[6][p.y] = empty;
-					board.state[7][p.y] = color_coeff==1? rook_w:rook_b;
-
-				} else if(m.x == -INFINITY_NUM){
-					p.x = 4;
-					castle_rook->x = 0;
-
-					board.state[0][p.y] = color_coeff==1? rook_w:rook_b;
-					board.state[1][p.y] = empty;
-					board.state[2][p.y] = empty;
-					board.state[3][p.y] = empty;
-					board.state[4][p.y] = color_coeff==1? king_w:king_b;
-
-				} else {
-					p.set(p_x, p_y);
-					board.state[p.x][p.y] = from_piece;
-					board.state[m.x][m.y] = to_piece;
-				}
-
-				board.warnedPosition.set(warnedPosition.x, warnedPosition.y);
-				board.castleBL = castleBL;
-				board.castleBR = castleBR;
-				board.castleWL = castleWL;
-				board.castleWR = castleWR;
-				
-				max_val = max(val, max_val);
-				alpha = max(alpha, max_val);
-				if(beta <= alpha)
-					return max_val;
-			}
+//plies a late quiet move is reduced by, growing with the depth left and the move's place in the list
+static const struct LmrReductions{
+	int table[MAX_PLY + 1][MAX_MOVES];
+	LmrReductions(){
+		for(int depth = 0; depth <= MAX_PLY; ++depth){
+			for(int i = 0; i < MAX_MOVES; ++i)
+				table[depth][i] = depth && i ? (int)(0.5 + log(depth) * log(i) / 2.5) : 0;
+		}
+	}
+} lmrReductions;
+
+int negamax(Board &board, int depth, int alpha, int beta, int color_coeff, SearchContext &ctx){
+	if(depth == 0 && ctx.limits->quiescence)
+		return quiesce(board, alpha, beta, color_coeff, ctx);
+
+	ctx.pv_length[ctx.ply] = ctx.ply;
+	++ctx.nodes;
+	if(outOfBudget(ctx))
+		return 0;
+	//a position seen before on the way here or in the game is scored a draw: repeating it once lets the side that
+	//would do no better repeat it again
+	if(ctx.ply > 0 && board.isRepeated(1))
+		return 0;
+
+	//three men left: the endgame tables know the result, the root still searches so there is a move to play
+	int table_score;
+	if(ctx.ply > 0 && probeEndgame(board, ctx.ply, table_score)){
+		STAT(endgame_hits, 1);
+		return table_score;
+	}
+	if(depth == 0)
+		return color_coeff * evaluate(board);
+
+	//a deep enough hash entry with a usable bound ends the search here
+	TTData entry;
+	Move first_move = Move();
+	STAT(tt_probes, 1);
+	if(ctx.shared->tt->probe(board.key, entry)){
+		STAT(tt_hits, 1);
+		first_move = Move(entry.move);
+		int tt_score = scoreFromTT(entry.score, ctx.ply);
+		if(entry.depth >= depth && (entry.bound == BOUND_EXACT
+				|| (entry.bound == BOUND_LOWER && tt_score >= beta)
+				|| (entry.bound == BOUND_UPPER && tt_score <= alpha))){
+			STAT(tt_cutoffs, 1);
+			return tt_score;
+		}
+	}
+
+	//while on the line of the previous iteration its move goes first, otherwise the hash move
+	if(ctx.follow_pv){
+		if(ctx.ply < ctx.prev_pv_length)
+			first_move = ctx.prev_pv[ctx.ply];
+		else
+			ctx.follow_pv = false;
+	}
+
+	const SearchLimits &limits = *ctx.limits;
+	bool in_check = isInCheck(board.turn == 1 ? king_w : king_b, board);
+
+	//if passing the turn still leaves the score above beta, a real move would too. not off the previous line, twice in a row,
+	//in check, or without pieces: with only king and pawns passing is often the best move there is (zugzwang)
+	Bitboard own_pieces = board.bitboard((Piece)(board.turn * rook_w)) | board.bitboard((Piece)(board.turn * knight_w))
+						| board.bitboard((Piece)(board.turn * bishop_w)) | board.bitboard((Piece)(board.turn * queen_w));
+	if(limits.null_move && depth >= NULL_MOVE_DEPTH && !ctx.follow_pv && !in_check && own_pieces && beta < MATE_BOUND
+			&& !(board.undoSize && board.undoStack[board.undoSize - 1].move == Move()) && color_coeff * evaluate(board) >= beta){
+		int r = depth >= 7 ? 3 : 2;		//deeper searches can afford to skip more
+		board.makeNullMove();
+		++ctx.ply;
+		int val = -negamax(board, max(depth - 1 - r, 0), -beta, -beta + 1, -color_coeff, ctx);
+		--ctx.ply;
+		board.unmakeNullMove();
+		if(ctx.stopped)
+			return 0;
+		if(val >= beta)
+			return val >= MATE_BOUND ? beta : val;		//a mate found by passing isn't proven
+	}
+
+	MoveList &moves = ctx.moves[ctx.ply];
+	moves.clear();
+	generateLegalMoves(board, moves);
+	STAT(generated, moves.size());
+	if(moves.empty())	//checkmate, or stalemate
+		return in_check ? -MATE_SCORE + ctx.ply : 0;
+
+	MovePicker picker(board, moves, first_move, ctx);
+	if(!picker.found_hash)
+		ctx.follow_pv = false;
+
+	int max_val = -INFINITY_NUM, alpha_orig = alpha;
+	Move best_move = Move();
+
+	for(Move m; picker.next(m); ){
+		board.makeMove(m);
+		++ctx.ply;
+
+		//quiet moves late in the list are unlikely to be best, a shallower search shows if they need a full one
+		int reduction = 0;
+		if(limits.lmr && depth >= LMR_DEPTH && picker.current > LMR_MOVES && !in_check && !m.isCapture() && !m.isPromotion()
+				&& !isInCheck(board.turn == 1 ? king_w : king_b, board))
+			reduction = min(lmrReductions.table[min(depth, MAX_PLY)][min(picker.current, MAX_MOVES - 1)], depth - 2);
+		bool scout = limits.pvs && picker.current > 1;
+
+		int val = alpha + 1;		//makes the full search below run unless a cheaper one settles the move
+		if(reduction)
+			val = -negamax(board, depth - 1 - reduction, scout ? -alpha - 1 : -beta, -alpha, -color_coeff, ctx);
+		if(scout && val > alpha)
+			val = -negamax(board, depth - 1, -alpha - 1, -alpha, -color_coeff, ctx);
+		if(val > alpha && (!scout || val < beta))
+			val = -negamax(board, depth - 1, -beta, -alpha, -color_coeff, ctx);
+		--ctx.ply;
+		board.unmakeMove();
+		ctx.follow_pv = false;		//only the first move continues the previous line
+		if(ctx.stopped)
+			return 0;
+
+		if(val > max_val){
+			max_val = val;
+			best_move = m;
+		}
+		if(val > alpha){
+			alpha = val;
+			updatePv(ctx, m);
+		}
+		if(beta <= alpha){
+			++ctx.cutoffs;
+			if(picker.current == 1)
+				++ctx.first_cutoffs;
+			if(!m.isCapture() && !m.isPromotion())
+				updateQuietStats(ctx, board.turn, m, depth);
+			ctx.shared->tt->store(board.key, depth, BOUND_LOWER, scoreToTT(max_val, ctx.ply), best_move.data);
+			return max_val;
 		}
 	}
 	
-	if(max_val == -INFINITY_NUM)
-		return color_coeff * board.getPointSum();	//stalemate
-	
+	ctx.shared->tt->store(board.key, depth, max_val <= alpha_orig ? BOUND_UPPER : BOUND_EXACT, scoreToTT(max_val, ctx.ply), best_move.data);
 	return max_val;
 }
 
-//picks best promotion option using minimax
-Piece handlePromotionChoice(const Coordinate &c, Board &board, int depth, CoordinateList& white, CoordinateList& black){
-	return c.y == 7 ? queen_b : queen_w;
+//one iteration over all root moves, the best move of the previous iteration goes first
+//searches the root moves inside (alpha, beta): a result at or below alpha, or at or above beta, is only a bound
+int searchRoot(Board &board, int depth, int alpha, int beta, int color_coeff, SearchContext &ctx, Move &best_move){
+	int max_val = -INFINITY_NUM, alpha_orig = alpha;
+	best_move = Move();
+	ctx.ply = 0;
+	ctx.pv_length[0] = 0;
+	ctx.follow_pv = ctx.prev_pv_length > 0;
 
-	int color_coeff = isWhite(board.get(c))? 1 : -1;
-	Piece possible[]{(Piece)(color_coeff*queen_w), (Piece)(color_coeff*rook_w), (Piece)(color_coeff*knight_w), (Piece)(color_coeff*bishop_w)};
-	Piece picked = possible[0];		//default
+	Move first_move = ctx.prev_pv_length ? ctx.prev_pv[0] : Move();
+	TTData entry;
+	if(first_move == Move() && ctx.shared->tt->probe(board.key, entry))
+		first_move = Move(entry.move);		//from an earlier search
 
-	int max_val = -INFINITY_NUM;
-	for(Piece &m: possible){
-		board.state[c.x][c.y] = m;
-		// by multiplying with -1 for minimising player becomes maximising (negamax)
-		int val = -negamax(board, depth, -INFINITY_NUM, INFINITY_NUM, -color_coeff, white, black);
-		if (val > max_val){
+	MoveList &moves = ctx.moves[0];
+	moves.clear();
+	generateLegalMoves(board, moves);
+	MovePicker picker(board, moves, first_move, ctx);
+	if(!picker.found_hash)
+		ctx.follow_pv = false;
+
+	for(Move m; picker.next(m); ){
+		board.makeMove(m);
+		++ctx.ply;
+		bool scout = ctx.limits->pvs && picker.current > 1;
+		int val = scout ? -negamax(board, depth - 1, -alpha - 1, -alpha, -color_coeff, ctx) : alpha + 1;
+		if(val > alpha && (!scout || val < beta))
+			val = -negamax(board, depth - 1, -beta, -alpha, -color_coeff, ctx);
+		--ctx.ply;
+		board.unmakeMove();
+		ctx.follow_pv = false;
+		if(ctx.stopped)
+			return 0;
+
+		if(val > max_val){
 			max_val = val;
-			picked = m;
+			best_move = m;
+			updatePv(ctx, m);
 		}
+		alpha = max(alpha, max_val);
+		if(alpha >= beta)
+			break;
 	}
-	board.state[c.x][c.y] = color_coeff==1 ? pawn_w : pawn_b;
-	return picked;
+
+	if(best_move != Move())
+		ctx.shared->tt->store(board.key, depth, max_val >= beta ? BOUND_LOWER : max_val <= alpha_orig ? BOUND_UPPER : BOUND_EXACT,
+								max_val, best_move.data);
+	return max_val;
+}
+
+//splits the clock across the moves left, returns the ms to spend on this move (0 when there is no limit)
+int allocateTime(const SearchLimits &limits, int color_coeff){
+	if(limits.movetime > 0)
+		return limits.movetime;
+
+	int side = color_coeff == 1 ? 0 : 1;
+	int left = limits.time[side], inc = limits.inc[side];
+	if(left <= 0)
+		return 0;
+
+	int moves_left = limits.movestogo > 0 ? min(limits.movestogo, 30) : 30;
+	int budget = left / moves_left + inc * 3 / 4;
+	int cap = max(left / 2 - MOVE_OVERHEAD, 1);		//never bet more than half the clock on one move
+	return max(min(budget, cap), 1);
 }
 
 Piece getMoveToMake(Coordinate &move_from, Coordinate &move_to, Board &board, int depth, int color_coeff){
+	SearchLimits limits;
+	limits.depth = depth;
+	return getMoveToMake(move_from, move_to, board, limits, color_coeff);
+}
 
-	CoordinateList black, white;
+//best move of the last iteration a thread finished
+struct RootResult{
+	Move move = Move();
+	int score = 0, depth = 0;
+	Move pv[MAX_PLY];
+	int pv_length = 0;
+};
 
-	for(int i = 3, x = i; i >= 0; x = (x==i)? BOARD_SIZE-i-1 : --i){
-		for(int y = 0; y < BOARD_SIZE; ++y){
-			//white from top to bottom, black bottom to top[so pawns come first]
-			if(isWhite(board.state[x][y]))
-				white.push_back(Coordinate(x, y));
-			if(isBlack(board.state[x][BOARD_SIZE - y - 1]))
-				black.push_back(Coordinate(x, BOARD_SIZE - y - 1));
+//search outcome so far, unreported: nodes of the calling thread not in shared.nodes yet
+void fillInfo(SearchInfo &info, const RootResult &result, SearchShared &shared, long long unreported){
+	info.move = result.move;
+	info.depth = result.depth;
+	info.score = result.score;
+	info.nodes = shared.nodes + unreported;
+	info.cutoffs = shared.cutoffs;
+	info.first_cutoffs = shared.first_cutoffs;
+	info.time = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - shared.start).count();
+	for(int i = 0; i < result.pv_length; ++i)
+		info.pv[i] = result.pv[i];
+	info.pv_length = result.pv_length;
+	info.stats = shared.stats;
+}
+
+#ifdef CHESS_STATS
+//adds the counters of a finished search thread
+static void addStats(SearchStats &to, const SearchStats &from){
+	to.qnodes += from.qnodes;
+	to.tt_probes += from.tt_probes;
+	to.tt_hits += from.tt_hits;
+	to.tt_cutoffs += from.tt_cutoffs;
+	to.endgame_hits += from.endgame_hits;
+	to.generations += from.generations;
+	to.generated += from.generated;
+	to.check_tests += from.check_tests;
+	to.moves_made += from.moves_made;
+}
+#endif
+
+//iterative deepening: searches depth 1, 2, 3... till the budget runs out and keeps the last finished iteration
+//helper threads run the same loop on their own board, odd ones one ply deeper, and only share the hash table
+void iterativeDeepening(Board &board, const SearchLimits &limits, int color_coeff, SearchShared &shared, int thread_id, RootResult &result, int soft_limit){
+	SearchContext ctx;
+	ctx.shared = &shared;
+	ctx.limits = &limits;
+	ctx.main_thread = thread_id == 0;
+#ifdef CHESS_STATS
+	threadStats = SearchStats();
+#endif
+
+	int max_depth = min(limits.depth, MAX_PLY - 1);
+	for(int iteration = 1; iteration <= max_depth; ++iteration){
+		int depth = min(iteration + thread_id % 2, max_depth);
+		Move best_move = Move();
+		ctx.iteration = iteration;
+
+		//a score outside the window is only a bound, the window widens that way till the score falls inside
+		int window = ASPIRATION_WINDOW, alpha = -INFINITY_NUM, beta = INFINITY_NUM;
+		if(limits.aspiration && iteration >= ASPIRATION_DEPTH && result.score > -MATE_BOUND && result.score < MATE_BOUND){
+			alpha = result.score - window;
+			beta = result.score + window;
 		}
-	}
+		int val;
+		while(true){
+			val = searchRoot(board, depth, alpha, beta, color_coeff, ctx, best_move);
+			if(ctx.stopped || best_move == Move())		//no legal move at the root: mate or stalemate
+				break;
+			if(val <= alpha)
+				alpha = max(val - window, -INFINITY_NUM);
+			else if(val >= beta)
+				beta = min(val + window, INFINITY_NUM);
+			else
+				break;
+			window *= 2;
+		}
+		if(ctx.stopped || best_move == Move())
+			break;
 
-	CoordinateList &pieces = color_coeff == -1? black:white;
-
-	int max_val = -INFINITY_NUM, alpha = -INFINITY_NUM;
-	Piece updated_piece;
-
-	for(auto &p : pieces){
-		CoordinateList moves;
-		getMoves(moves, p, board, false);
-		for(auto &m : moves){
-			//make backup
-			Piece just_moved = empty, from_piece = board.get(p), 
-				to_piece = (m.x != INFINITY_NUM && m.x != -INFINITY_NUM) ? board.get(m) : empty;
-			Coordinate warnedPosition(board.warnedPosition);
-			bool castleBL = board.castleBL, castleBR = board.castleBR, castleWL = board.castleWL, castleWR = board.castleWR;
-			
-			movePieceCalcPromotion(board, p, m, depth, white, black);
-
-			int p_x = p.x, p_y = p.y;
-			Coordinate *castle_rook = nullptr;
-			if(m.x == INFINITY_NUM){
-				p.x = 6;
-				for(auto &pos: pieces){
-					if(pos.x == 7 && pos.y == p.y){
-						pos.x = 5;
-						castle_rook = &pos;
-						break;
-					}
-				}
-			} else if(m.x == -INFINITY_NUM){
-				p.x = 2;
-				for(auto &pos: pieces){
-					if(pos.x == 0 && pos.y == p.y){
-						pos.x = 3;
-						castle_rook = &pos;
-						break;
-					}
-				}
-			} else {
-				just_moved = board.get(m);
-				p.set(m.x, m.y);
-			}
+		result.move = best_move;
+		result.score = val;
+		result.depth = depth;
+		for(int i = 0; i < ctx.pv_length[0]; ++i)
+			result.pv[i] = ctx.prev_pv[i] = ctx.pv[0][i];
+		result.pv_length = ctx.prev_pv_length = ctx.pv_length[0];
 
-			int val = -negamax(board, depth - 1, -INFINITY_NUM, -alpha, -color_coeff, white, black);
-
-			//restore backup
-			if(m.x == INFINITY_NUM){
-				p.x = 4;
-				castle_rook->x = 7;
-
-				board.state[4][p.y] = color_coeff==1? king_w:king_b;
-				board.state[5][p.y] = empty;
-				board.state[6][p.y] = empty;
-				board.state[7][p.y] = color_coeff==1? rook_w:rook_b;
-			} else if(m.x == -INFINITY_NUM){
-				p.x = 4;
-				castle_rook->x = 0;
-
-				board.state[0][p.y] = color_coeff==1? rook_w:rook_b;
-				board.state[1][p.y] = empty;
-				board.state[2][p.y] = empty;
-				board.state[3][p.y] = empty;
-				board.state[4][p.y] = color_coeff==1? king_w:king_b;
-			} else {
-				p.set(p_x, p_y);
-				board.state[p.x][p.y] = from_piece;
-				board.state[m.x][m.y] = to_piece;
-			}
-			board.warnedPosition.set(warnedPosition.x, warnedPosition.y);
-			board.castleBL = castleBL;
-			board.castleBR = castleBR;
-			board.castleWL = castleWL;
-			board.castleWR = castleWR;
-
-			if (val > max_val){
-				max_val = val;
-				move_from.set(p.x, p.y);
-				move_to.set(m.x, m.y);
-				updated_piece = just_moved;		//promotion
-			}
-			alpha = max(alpha, max_val);
+		if(ctx.main_thread){
+			SearchStats &stats = shared.stats;
+			stats.iteration_nodes[stats.iterations] = shared.nodes + ctx.nodes - ctx.reported;
+			stats.iteration_time[stats.iterations++] = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - shared.start).count();
+		}
+		if(ctx.main_thread && limits.progress){
+			SearchInfo info;
+			fillInfo(info, result, shared, ctx.nodes - ctx.reported);
+			info.cutoffs += ctx.cutoffs;
+			info.first_cutoffs += ctx.first_cutoffs;
+			limits.progress(info);
+		}
+
+		if(ctx.main_thread){
+			int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - shared.start).count();
+			if((clockRunning(shared) && elapsed >= soft_limit) || (shared.node_limit && shared.nodes + ctx.nodes - ctx.reported >= shared.node_limit))
+				break;
 		}
 	}
-	return updated_piece;
+	shared.nodes += ctx.nodes - ctx.reported;
+	shared.cutoffs += ctx.cutoffs;
+	shared.first_cutoffs += ctx.first_cutoffs;
+#ifdef CHESS_STATS
+	std::lock_guard<std::mutex> lock(shared.stats_mutex);
+	addStats(shared.stats, threadStats);
+#endif
+}
+
+//returns the piece that ends up on the destination square (the promoted piece for promotions)
+Piece getMoveToMake(Coordinate &move_from, Coordinate &move_to, Board &board, const SearchLimits &limits, int color_coeff, SearchInfo *info){
+	SearchShared shared;
+	shared.start = Clock::now();
+	shared.node_limit = limits.nodes;
+	shared.external_stop = limits.stop;
+	shared.ponder = limits.ponder;
+
+	//the hard limit aborts an iteration, past the soft limit no new iteration is started
+	int budget = allocateTime(limits, color_coeff), soft_limit = budget;
+	if(budget){
+		shared.timed = true;
+		shared.deadline = shared.start + std::chrono::milliseconds(budget);
+		if(limits.movetime <= 0)
+			soft_limit = budget / 2;
+	}
+
+	shared.tt = limits.tt ? limits.tt : &transpositionTable;
+	if(limits.new_generation)
+		shared.tt->newSearch();
+
+	//helpers copy the root position onto their own stack before the main thread starts changing it,
+	//so the only heap allocations of a search are the helper threads' starts
+	int helper_count = min(max(limits.threads, 1), MAX_THREADS) - 1;
+	std::thread helpers[MAX_THREADS - 1];
+	std::atomic<int> copied(0);
+	for(int i = 1; i <= helper_count; ++i){
+		helpers[i - 1] = std::thread([&, i]{
+			Board own = board;
+			RootResult own_result;
+			++copied;
+			iterativeDeepening(own, limits, color_coeff, shared, i, own_result, soft_limit);
+		});
+	}
+	while(copied < helper_count)
+		std::this_thread::yield();
+
+	RootResult result;
+	iterativeDeepening(board, limits, color_coeff, shared, 0, result, soft_limit);
+	shared.stop = true;
+	for(int i = 0; i < helper_count; ++i)
+		helpers[i].join();
+
+	Piece moved = empty;
+	if(result.move != Move()){
+		move_from.set(squareX(result.move.from()), squareY(result.move.from()));
+		move_to = toCoordinate(result.move);
+		moved = result.move.isPromotion() ? result.move.promotion(color_coeff) 
+				: result.move.isCastle() ? empty : board.state[move_from.x][move_from.y];
+	}
+	if(info)
+		fillInfo(*info, result, shared, 0);
+	return moved;
+}
+
+SearchSession::~SearchSession(){
+	stop();
+	if(thread.joinable())
+		thread.join();
+}
+
+std::future<SearchInfo> SearchSession::start(const Board &position, const SearchLimits &limits, bool ponder){
+	stop();
+	if(thread.joinable())
+		thread.join();
+	stop_flag = false;
+	pondering = ponder;
+	running = true;
+
+	SearchLimits session_limits = limits;
+	session_limits.stop = &stop_flag;
+	session_limits.ponder = &pondering;
+	std::promise<SearchInfo> promise;
+	std::future<SearchInfo> result = promise.get_future();
+	thread = std::thread([this, board = position, session_limits](std::promise<SearchInfo> promise) mutable {
+		SearchInfo info;
+		Coordinate from, to;
+		getMoveToMake(from, to, board, session_limits, board.turn, &info);
+		//a ponder search that ran out of depth keeps its answer till the opponent's move is known
+		while(pondering && !stop_flag)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		promise.set_value(info);
+		running = false;
+	}, std::move(promise));
+	return result;
+}
+
+void SearchSession::stop(){
+	pondering = false;
+	stop_flag = true;
+}
+
+void SearchSession::ponderhit(){
+	pondering = false;
+}
+
+//one line of JSON describing a finished search, for logs and dashboards
+std::string searchStatsJson(const SearchInfo &info){
+	const SearchStats &stats = info.stats;
+	std::ostringstream out;
+	out << "{\"move\":\"" << (info.move != Move() ? moveToString(info.move) : std::string("0000")) << "\""
+		<< ",\"depth\":" << info.depth << ",\"score\":" << info.score << ",\"nodes\":" << info.nodes
+		<< ",\"time_ms\":" << info.time << ",\"nps\":" << (info.time > 0 ? info.nodes * 1000 / info.time : info.nodes)
+		<< ",\"cutoffs\":" << info.cutoffs << ",\"first_cutoffs\":" << info.first_cutoffs;
+
+	//effective branching factor: how many times more nodes the last iteration took than the one before
+	long long last = 0, before = 0;
+	out << ",\"iterations\":[";
+	for(int i = 0; i < stats.iterations; ++i){
+		long long nodes = stats.iteration_nodes[i] - (i ? stats.iteration_nodes[i - 1] : 0);
+		int time = stats.iteration_time[i] - (i ? stats.iteration_time[i - 1] : 0);
+		before = last;
+		last = nodes;
+		out << (i ? "," : "") << "{\"depth\":" << i + 1 << ",\"nodes\":" << nodes << ",\"time_ms\":" << time << "}";
+	}
+	out << "],\"ebf\":" << (before ? (double)last / before : 0.0);
+
+#ifdef CHESS_STATS
+	out << ",\"counters\":{\"qnodes\":" << stats.qnodes << ",\"tt_probes\":" << stats.tt_probes << ",\"tt_hits\":" << stats.tt_hits
+		<< ",\"tt_cutoffs\":" << stats.tt_cutoffs << ",\"endgame_hits\":" << stats.endgame_hits
+		<< ",\"generations\":" << stats.generations << ",\"generated\":" << stats.generated
+		<< ",\"check_tests\":" << stats.check_tests << ",\"moves_made\":" << stats.moves_made << "}";
+#else
+	out << ",\"counters\":null";
+#endif
+	out << "}";
+	return out.str();
 }
@@ -1,10 +1,29 @@
 #ifndef CHESS_H
 #define CHESS_H
 
-#define INFINITY_NUM 1000
+#define INFINITY_NUM 32000		//scores are in centipawns
 #define BOARD_SIZE 8
+#define MAX_PLY 64
+#define MAX_THREADS 256		//search threads one search can run
+#define MATE_SCORE (INFINITY_NUM - 100)		//score of giving mate now, mate in n plies scores MATE_SCORE - n
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)		//scores beyond this are mates
+#define MAX_HISTORY 512		//moves a board can take back
+#define MAX_MOVES 256		//more than any position has
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"		//what a default constructed Board holds
 
+#include<atomic>
+#include<chrono>
+#include<functional>
+#include<future>
+#include<iosfwd>
+#include<string>
+#include<thread>
 #include<vector>
+#include "bitboard.h"
+
+struct TranspositionTable;
+
+typedef std::chrono::steady_clock Clock;
 
 enum Piece{
 	pawn_w = 1, pawn_b = -1,
@@ -27,6 +46,105 @@ struct Coordinate{
 
 typedef std::vector<Coordinate> CoordinateList;
 
+//move kinds, kept in the top four bits of a Move
+enum MoveFlag{
+	MOVE_QUIET = 0,
+	MOVE_CASTLE_KING = 2,		//king to the g file
+	MOVE_CASTLE_QUEEN = 3,		//king to the c file
+	MOVE_CAPTURE = 4,
+	MOVE_PROMOTION = 8			//low two bits pick knight, bishop, rook or queen, may be or'ed with MOVE_CAPTURE
+};
+
+//16 bit move: from square [0, 6), to square [6, 12), flags [12, 16). castling stores the king's destination
+struct Move{
+	uint16_t data;
+
+	Move() = default;		//uninitialized, so move buffers cost nothing to create; Move() is the null move
+	explicit Move(uint16_t data) : data(data){}
+	Move(int from, int to, int flags) : data(from | to << 6 | flags << 12){}
+	int from() const { return data & 63; }
+	int to() const { return (data >> 6) & 63; }
+	int flags() const { return data >> 12; }
+	bool isCapture() const { return flags() & MOVE_CAPTURE; }
+	bool isPromotion() const { return flags() & MOVE_PROMOTION; }
+	bool isCastle() const { return flags() == MOVE_CASTLE_KING || flags() == MOVE_CASTLE_QUEEN; }
+	Piece promotion(int color_coeff) const;
+	bool operator==(const Move &m) const { return data == m.data; }
+	bool operator!=(const Move &m) const { return data != m.data; }
+};
+
+//fixed-capacity move buffer, lives on the stack or in the search's per-ply arena so generating moves never allocates
+struct MoveList{
+	Move moves[MAX_MOVES];
+	int count = 0;
+
+	void push_back(Move m){ moves[count++] = m; }
+	void clear(){ count = 0; }
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+	Move &operator[](int i){ return moves[i]; }
+	Move *begin(){ return moves; }
+	Move *end(){ return moves + count; }
+};
+
+//what makeMove overwrites, so unmakeMove can put it back
+struct UndoInfo{
+	Move move;
+	Piece captured;
+	int castleRights;
+	Coordinate warnedPosition;
+	uint64_t key;
+	int halfmoveClock;
+};
+
+//where a search went: per iteration figures are always kept, the counters only in builds with -DCHESS_STATS
+struct SearchStats{
+	long long qnodes;						//of the nodes, how many were in the quiescence search
+	long long tt_probes, tt_hits, tt_cutoffs;
+	long long endgame_hits;
+	long long generations, generated;		//generateLegal calls, and moves generated at search nodes
+	long long check_tests;					//isSquareAttacked calls, isInCheck included (counted once, in isSquareAttacked)
+	long long moves_made;
+	int iterations;
+	long long iteration_nodes[MAX_PLY];		//nodes searched when each iteration finished
+	int iteration_time[MAX_PLY];			//ms
+};
+
+//outcome of the last finished iteration
+struct SearchInfo{
+	Move move;
+	int depth, score;
+	long long nodes;
+	long long cutoffs, first_cutoffs;		//beta cutoffs, and how many of them the first move searched gave
+	int time;		//ms
+	Move pv[MAX_PLY];
+	int pv_length;
+	SearchStats stats;
+};
+
+//budget for getMoveToMake, the search stops at whichever limit is hit first
+struct SearchLimits{
+	int depth = MAX_PLY;
+	int movetime = 0;			//ms for this move
+	long long nodes = 0;
+	int time[2] = {0, 0};		//game clock left for white and black in ms
+	int inc[2] = {0, 0};		//increment per move
+	int movestogo = 0;			//moves till the next time control, 0 for sudden death
+	int threads = 1;			//search threads sharing the hash table (lazy SMP)
+	bool quiescence = true;		//resolve captures and promotions at the leaves instead of scoring mid-exchange
+	bool pvs = true;			//moves after the first get a zero window scout, re-searched only if they beat alpha
+	bool aspiration = true;		//iterations start from a narrow window around the last score
+	bool null_move = true;		//pass the turn at a reduced depth, a score still above beta cuts the node off
+	bool lmr = true;			//quiet moves late in the list are searched shallower first
+	bool new_generation = true;	//age the hash table's entries, off when many independent searches share it (the server ages it on a timer)
+	TranspositionTable *tt = nullptr;	//the hash table searched, the global transpositionTable when null
+
+	const std::atomic<bool> *stop = nullptr;			//set from another thread to end the search early
+	const std::atomic<bool> *ponder = nullptr;			//while set the search is on the opponent's time and the clock limits wait,
+														//they count from the start of the search once it is cleared
+	std::function<void(const SearchInfo &)> progress;	//called by the main search thread after every iteration
+};
+
 struct Board{
 	Piece state[8][8] = {
 		{  rook_b, pawn_b, empty, empty, empty, empty, pawn_w, rook_w  },
@@ -39,24 +157,86 @@ struct Board{
 		{  rook_b, pawn_b, empty, empty, empty, empty, pawn_w, rook_w  }
 	};
 
-	Coordinate warnedPosition;
+	//kept in sync with state by set(), pieces is indexed by Piece + 6 (pieces[6] holds the empty squares)
+	Bitboard pieces[13];
+	Bitboard whitePieces, blackPieces;
+	int kings[2];		//squares of the white and black king (-1 once captured), kept by set()
+
+	Coordinate warnedPosition;		//king left in check by the last movePiece, for the gui
 	bool castleBL = true, castleBR = true, castleWL = true, castleWR = true;
+	int turn = 1;		//1 when white is to move, -1 for black
+	uint64_t key;		//zobrist hash of pieces, castle flags and turn
+	int psq;		//sum of the piece square table entries (eval.h), packed middlegame and endgame, updated by set()
+	int halfmoveClock = 0;		//plies since the last capture or pawn move
+	int fullmoveNumber = 1;
+
+	UndoInfo undoStack[MAX_HISTORY];
+	int undoSize = 0;
 
+	Board();
 	Piece get(const Coordinate &c);
+	void set(int x, int y, Piece p);
+	Bitboard bitboard(Piece p);
+	Bitboard occupied();
+	void syncBitboards();
+	int castleRights();
+	void setCastleRights(int rights);
+	uint64_t computeKey();
+	int kingSquare(bool white);
 	Coordinate find(Piece p);
-	int getPointSum();
+	int getPstSum();
+	int computePstSum();
+	void makeMove(Move m);
+	void unmakeMove();
+	void makeNullMove();		//passes the turn, for null move pruning; taken back by unmakeNullMove
+	void unmakeNullMove();
+	bool setFen(const std::string &fen);
+	std::string getFen();
+	bool isRepeated(int times);
 };
 
 int getPoints(Piece p);
 
+void generatePieceMoves(Board &board, int sq, MoveList &moves);
+void generateLegalMoves(Board &board, MoveList &moves);
+void generateLegal(Board &board, bool white, Bitboard from_mask, MoveList &moves, bool noisy = false);
+void playMove(Board &board, Move m);
+std::string moveToString(Move m);
+Move parseMove(Board &board, const std::string &s);
+bool setPosition(Board &board, std::istream &in, std::string &error);
+
 void getMoves(CoordinateList &validMoves, const Coordinate &pos, Board &board, bool removeInvalid);
 void movePiece(Board &board, const Coordinate &from, const Coordinate &to, Piece (*getPromotionChoice)());
 Piece getMoveToMake(Coordinate &move_from, Coordinate &move_to, Board &board, int depth, int color_coeff);
+Piece getMoveToMake(Coordinate &move_from, Coordinate &move_to, Board &board, const SearchLimits &limits, int color_coeff, SearchInfo *info = nullptr);
+int allocateTime(const SearchLimits &limits, int color_coeff);
+
+//runs searches on a thread of its own, for hosts that can't block while the engine thinks (the gui's message loop, a protocol reader)
+//progress callbacks come from the search thread, the future gets the last finished iteration when the search ends
+struct SearchSession{
+	SearchSession() = default;
+	SearchSession(const SearchSession &) = delete;
+	SearchSession &operator=(const SearchSession &) = delete;
+	~SearchSession();		//stops and waits for a running search
+
+	//searches a copy of position for its side to move, after stopping a running search. limits.stop and limits.ponder are the session's own
+	//ponder: position is after the opponent's expected move, the search runs till ponderhit() or stop() and answers only then
+	std::future<SearchInfo> start(const Board &position, const SearchLimits &limits, bool ponder = false);
+	void stop();			//returns at once, the search notices at its next node
+	void ponderhit();		//the expected move was played: the time already spent counts, an answer already found is given straight away
+	bool isSearching() const { return running; }
+
+private:
+	std::thread thread;
+	std::atomic<bool> stop_flag{false}, pondering{false}, running{false};
+};
+std::string searchStatsJson(const SearchInfo &info);
 
 bool isBlack(Piece p);
 bool isWhite(Piece p);
 bool isEmpty(Board &board, int x, int y);
 
 bool isInCheck(Piece checkPiece, Board &board);
+bool isSquareAttacked(Board &board, int sq, bool byWhite);
 
 #endif
\ No newline at end of file
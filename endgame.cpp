@@ -0,0 +1,252 @@
+#include "endgame.h"
+#include<cstdlib>
+#include<vector>
+
+#define KPK_SIZE (2 * 24 * 64 * 64)		//side to move, white pawn on files a-d ranks 2-7, black king, white king
+#define KXK_SIZE (10 * 64 * 64 * 2)		//white king in the a1-d1-d4 triangle, black king, white piece, side to move
+
+enum KpkResult{
+	KPK_INVALID = 0,
+	KPK_UNKNOWN = 1,
+	KPK_DRAW = 2,
+	KPK_WIN = 4
+};
+
+static int kpkIndex(bool white_to_move, int wk, int bk, int pawn){
+	return wk | bk << 6 | white_to_move << 12 | (pawn & 3) << 13 | ((pawn >> 3) - 1) << 15;
+}
+
+//squares a king can't step to: next to the other king
+static Bitboard kingZone(int sq){
+	return kingAttacks(sq) | squareBB(sq);
+}
+
+//king and pawn against king, one bit per position, set when white wins
+struct KpkBitbase{
+	uint64_t bits[KPK_SIZE / 64];
+
+	KpkBitbase();
+	bool isWin(bool white_to_move, int wk, int bk, int pawn) const {
+		int i = kpkIndex(white_to_move, wk, bk, pawn);
+		return bits[i >> 6] >> (i & 63) & 1;
+	}
+};
+
+//start from what is clear without looking ahead (promotions that can't be stopped, stalemates, the pawn falling)
+//then back up results till nothing changes: white wins if a move wins, black draws if a move draws
+KpkBitbase::KpkBitbase(){
+	std::vector<unsigned char> result(KPK_SIZE);
+	for(int i = 0; i < KPK_SIZE; ++i){
+		bool white_to_move = i >> 12 & 1;
+		int wk = i & 63, bk = i >> 6 & 63, pawn = (i >> 13 & 3) + 8 * ((i >> 15) + 1);
+
+		if(wk == bk || wk == pawn || bk == pawn || (kingAttacks(wk) & squareBB(bk))
+				|| (white_to_move && (pawnAttacks(true, pawn) & squareBB(bk))))
+			result[i] = KPK_INVALID;
+		else if(white_to_move && pawn >> 3 == 6 && wk != pawn + 8 && bk != pawn + 8
+				&& (!(kingZone(bk) & squareBB(pawn + 8)) || (kingAttacks(wk) & squareBB(pawn + 8))))
+			result[i] = KPK_WIN;
+		else if(!white_to_move && (!(kingAttacks(bk) & ~(kingAttacks(wk) | pawnAttacks(true, pawn)))
+				|| (kingAttacks(bk) & squareBB(pawn) & ~kingAttacks(wk))))
+			result[i] = KPK_DRAW;
+		else
+			result[i] = KPK_UNKNOWN;
+	}
+
+	for(bool changed = true; changed; ){
+		changed = false;
+		for(int i = 0; i < KPK_SIZE; ++i){
+			if(result[i] != KPK_UNKNOWN)
+				continue;
+			bool white_to_move = i >> 12 & 1;
+			int wk = i & 63, bk = i >> 6 & 63, pawn = (i >> 13 & 3) + 8 * ((i >> 15) + 1);
+
+			int reached = 0;
+			if(white_to_move){
+				for(Bitboard b = kingAttacks(wk) & ~kingZone(bk) & ~squareBB(pawn); b; )
+					reached |= result[kpkIndex(false, popLsb(b), bk, pawn)];
+				//pushes up to the 7th rank, promotions are settled above
+				int push = pawn + 8;
+				if(pawn >> 3 < 6 && push != wk && push != bk){
+					reached |= result[kpkIndex(false, wk, bk, push)];
+					if(pawn >> 3 == 1 && push + 8 != wk && push + 8 != bk)
+						reached |= result[kpkIndex(false, wk, bk, push + 8)];
+				}
+			} else {
+				for(Bitboard b = kingAttacks(bk) & ~(kingAttacks(wk) | pawnAttacks(true, pawn)); b; )
+					reached |= result[kpkIndex(true, wk, popLsb(b), pawn)];
+			}
+
+			int good = white_to_move ? KPK_WIN : KPK_DRAW, bad = white_to_move ? KPK_DRAW : KPK_WIN;
+			int r = reached & good ? good : reached & KPK_UNKNOWN ? KPK_UNKNOWN : bad;
+			if(r != KPK_UNKNOWN){
+				result[i] = r;
+				changed = true;
+			}
+		}
+	}
+
+	//anything still unknown can't be forced, so it's a draw
+	for(int i = 0; i < KPK_SIZE / 64; ++i)
+		bits[i] = 0;
+	for(int i = 0; i < KPK_SIZE; ++i){
+		if(result[i] == KPK_WIN)
+			bits[i >> 6] |= 1ULL << (i & 63);
+	}
+}
+
+//index in the a1-d1-d4 triangle, -1 off it
+static const signed char triangle[64] = {
+	 0,  1,  2,  3, -1, -1, -1, -1,
+	-1,  4,  5,  6, -1, -1, -1, -1,
+	-1, -1,  7,  8, -1, -1, -1, -1,
+	-1, -1, -1,  9, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+};
+static const int triangleSquares[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+static int transpose(int sq){
+	return (sq & 7) << 3 | sq >> 3;
+}
+
+//the board is mirrored and turned till the white king is in the triangle, that is the same position for a lone rook or queen
+static int kxkIndex(bool white_to_move, int wk, int bk, int piece){
+	if(wk & 4){
+		wk ^= 7; bk ^= 7; piece ^= 7;
+	}
+	if(wk & 32){
+		wk ^= 56; bk ^= 56; piece ^= 56;
+	}
+	if(wk >> 3 > (wk & 7)){
+		wk = transpose(wk); bk = transpose(bk); piece = transpose(piece);
+	}
+	return ((triangle[wk] * 64 + bk) * 64 + piece) * 2 + white_to_move;
+}
+
+//king and rook (or queen) against king: plies to mate + 1 for every position, 0 when white can't win
+struct KxkTable{
+	unsigned char dtm[KXK_SIZE];
+
+	explicit KxkTable(bool queen);
+	int pliesToMate(bool white_to_move, int wk, int bk, int piece) const {
+		return dtm[kxkIndex(white_to_move, wk, bk, piece)] - 1;
+	}
+};
+
+//forward passes: on odd passes white to move is mate in n if a move reaches a position lost in n - 1,
+//on even passes black to move is lost in n if every move goes to a white win in n - 1 or less
+KxkTable::KxkTable(bool queen){
+	auto attacks = [queen](int sq, Bitboard occupied){
+		return queen ? queenAttacks(sq, occupied) : rookAttacks(sq, occupied);
+	};
+	std::vector<bool> valid(KXK_SIZE);
+	for(int i = 0; i < KXK_SIZE; ++i)
+		dtm[i] = 0;
+
+	for(int t = 0; t < 10; ++t)
+	for(int bk = 0; bk < 64; ++bk)
+	for(int piece = 0; piece < 64; ++piece){
+		int wk = triangleSquares[t];
+		if(wk == bk || wk == piece || bk == piece || (kingAttacks(wk) & squareBB(bk)))
+			continue;
+		Bitboard checks = attacks(piece, squareBB(wk) | squareBB(bk)) & squareBB(bk);
+		int w = ((t * 64 + bk) * 64 + piece) * 2;
+		valid[w + 1] = !checks;		//white can't be to move with black in check
+		valid[w] = true;
+
+		//black mated now
+		Bitboard escapes = kingAttacks(bk) & ~kingAttacks(wk) & ~attacks(piece, squareBB(wk) | squareBB(piece));
+		if(!escapes && checks)
+			dtm[w] = 1;
+	}
+
+	for(int pass = 1, quiet = 0; quiet < 2; ++pass){
+		bool changed = false;
+		bool white_to_move = pass & 1;
+		for(int t = 0; t < 10; ++t)
+		for(int bk = 0; bk < 64; ++bk)
+		for(int piece = 0; piece < 64; ++piece){
+			int wk = triangleSquares[t];
+			int i = ((t * 64 + bk) * 64 + piece) * 2 + white_to_move;
+			if(!valid[i] || dtm[i])
+				continue;
+
+			if(white_to_move){
+				bool mates = false;
+				for(Bitboard b = kingAttacks(wk) & ~kingZone(bk) & ~squareBB(piece); b && !mates; )
+					mates = dtm[kxkIndex(false, popLsb(b), bk, piece)] == pass;
+				for(Bitboard b = attacks(piece, squareBB(wk) | squareBB(bk)) & ~squareBB(wk) & ~squareBB(bk); b && !mates; )
+					mates = dtm[kxkIndex(false, wk, bk, popLsb(b))] == pass;
+				if(mates){
+					dtm[i] = pass + 1;
+					changed = true;
+				}
+			} else {
+				Bitboard escapes = kingAttacks(bk) & ~kingAttacks(wk) & ~attacks(piece, squareBB(wk) | squareBB(piece));
+				//stalemate, or the piece hangs
+				if(!escapes || (escapes & squareBB(piece)))
+					continue;
+				bool lost = true;
+				for(Bitboard b = escapes; b && lost; )
+					lost = dtm[kxkIndex(true, wk, popLsb(b), piece)] != 0;
+				if(lost){
+					dtm[i] = pass + 1;
+					changed = true;
+				}
+			}
+		}
+		quiet = changed ? 0 : quiet + 1;
+	}
+}
+
+bool probeEndgame(Board &board, int ply, int &score){
+	Bitboard occupied = board.occupied();
+	if(popCount(occupied) > 3)
+		return false;
+	Bitboard others = occupied & ~board.bitboard(king_w) & ~board.bitboard(king_b);
+	if(!others){
+		score = 0;
+		return true;
+	}
+
+	//the side with the extra man is made white, turning the board over if it is black
+	int sq = lsb(others);
+	Piece p = board.state[squareX(sq)][squareY(sq)];
+	bool flip = p < 0;
+	int wk = board.kingSquare(!flip), bk = board.kingSquare(flip);
+	if(wk < 0 || bk < 0)
+		return false;		//not a real position, the tables are indexed by both kings
+	if(flip){
+		sq ^= 56; wk ^= 56; bk ^= 56;
+	}
+	bool strong_to_move = (board.turn == 1) != flip;
+
+	switch(abs(p)){
+		case pawn_w:{
+			static const KpkBitbase kpk;
+			if(sq < 8 || sq >= 56)
+				return false;		//kpkIndex only covers pawns on ranks 2 to 7
+			if(sq & 4){
+				sq ^= 7; wk ^= 7; bk ^= 7;
+			}
+			//a won pawn ending counts more the further the pawn is, so the search pushes it
+			score = kpk.isWin(strong_to_move, wk, bk, sq) ? KNOWN_WIN + (sq >> 3) : 0;
+			break;
+		}
+		case rook_w: case queen_w:{
+			static const KxkTable krk(false), kqk(true);
+			int plies = (abs(p) == queen_w ? kqk : krk).pliesToMate(strong_to_move, wk, bk, sq);
+			score = plies >= 0 ? MATE_SCORE - ply - plies : 0;
+			break;
+		}
+		default:		//a lone knight or bishop can't mate
+			score = 0;
+			return true;
+	}
+	if(!strong_to_move)
+		score = -score;
+	return true;
+}
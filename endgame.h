@@ -0,0 +1,13 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "chess.h"
+
+#define KNOWN_WIN (MATE_BOUND / 2)		//a won ending that isn't a counted mate, above any material but below every mate
+
+//exact result of a position with at most three men (kings and a pawn, rook, queen, knight or bishop),
+//from the side to move's point of view: KPK from a win/draw bitbase, KRK and KQK as mate scores from distance to mate tables.
+//false if the position has more men; the tables are built by a retrograde pass on the first call
+bool probeEndgame(Board &board, int ply, int &score);
+
+#endif
@@ -0,0 +1,191 @@
+/* Batch analysis of an EPD file (one position per line), searched by a pool of worker threads.
+	build: g++ -O2 -pthread epd.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp -o epd
+	usage: epd <file | -> [-d depth] [-n nodes] [-j jobs] [-H hash_mb] [-s stats_file]
+	the file is read as the workers need it, so any number of positions fits in memory.
+	results are written as they finish, one tab separated line per position:
+		line	bestmove	score (centipawns)	nodes	time (ms)	id
+	lines come out in the order they finish, the first column says which input line they belong to
+*/
+#include "chess.h"
+#include "tt.h"
+#include<atomic>
+#include<chrono>
+#include<condition_variable>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<mutex>
+#include<queue>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+
+struct Job{
+	long long line;
+	std::string epd;
+};
+
+//hands lines from the reader to the workers, the reader blocks while it is full
+struct JobQueue{
+	std::queue<Job> jobs;
+	size_t capacity;
+	bool closed = false;
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	explicit JobQueue(size_t capacity) : capacity(capacity){}
+
+	void push(Job job){
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]{ return jobs.size() < capacity; });
+		jobs.push(std::move(job));
+		changed.notify_all();
+	}
+	//no more jobs will come
+	void close(){
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		changed.notify_all();
+	}
+	//false once the queue is closed and empty
+	bool pop(Job &job){
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]{ return !jobs.empty() || closed; });
+		if(jobs.empty())
+			return false;
+		job = std::move(jobs.front());
+		jobs.pop();
+		changed.notify_all();
+		return true;
+	}
+};
+
+std::mutex outputMutex;
+FILE *statsFile = nullptr;		//-s: a JSON line per search, with the input line number added
+std::atomic<long long> searched(0), failed(0), totalNodes(0);
+
+//the id "..." operation of an EPD line, empty if it has none
+std::string epdId(const std::string &epd){
+	size_t pos = epd.find("id \"");
+	if(pos == std::string::npos)
+		return "";
+	pos += 4;
+	size_t end = epd.find('"', pos);
+	return epd.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+//an EPD line is the first four FEN fields followed by operations, the move counters are left out
+bool readEpd(Board &board, const std::string &epd){
+	std::istringstream in(epd);
+	std::string placement, side, castling, en_passant;
+	if(!(in >> placement >> side >> castling >> en_passant))
+		return false;
+	return board.setFen(placement + " " + side + " " + castling + " " + en_passant + " 0 1");
+}
+
+void worker(JobQueue &queue, const SearchLimits &limits){
+	Job job;
+	while(queue.pop(job)){
+		Board board;
+		if(!readEpd(board, job.epd)){
+			++failed;
+			std::lock_guard<std::mutex> lock(outputMutex);
+			fprintf(stderr, "line %lld: can't read position\n", job.line);
+			continue;
+		}
+
+		Coordinate from, to;
+		SearchInfo info;
+		auto start = std::chrono::steady_clock::now();
+		getMoveToMake(from, to, board, limits, board.turn, &info);
+		long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		++searched;
+		totalNodes += info.nodes;
+		std::lock_guard<std::mutex> lock(outputMutex);
+		printf("%lld\t%s\t%d\t%lld\t%lld\t%s\n", job.line, info.move != Move() ? moveToString(info.move).c_str() : "0000",
+				info.score, info.nodes, ms, epdId(job.epd).c_str());
+		if(statsFile)
+			fprintf(statsFile, "{\"line\":%lld,%s\n", job.line, searchStatsJson(info).c_str() + 1);
+	}
+}
+
+int main(int argc, char *argv[]){
+	if(argc < 2){
+		fprintf(stderr, "usage: %s <file | -> [-d depth] [-n nodes] [-j jobs] [-H hash_mb] [-s stats_file]\n", argv[0]);
+		return 1;
+	}
+
+	SearchLimits limits;
+	bool depth_given = false;
+	int jobs = std::thread::hardware_concurrency();
+	int hash_mb = 64;
+	for(int i = 2; i + 1 < argc; i += 2){
+		if(!strcmp(argv[i], "-d")){
+			limits.depth = atoi(argv[i + 1]);
+			depth_given = true;
+		} else if(!strcmp(argv[i], "-n"))
+			limits.nodes = atoll(argv[i + 1]);
+		else if(!strcmp(argv[i], "-j"))
+			jobs = atoi(argv[i + 1]);
+		else if(!strcmp(argv[i], "-H"))
+			hash_mb = atoi(argv[i + 1]);
+		else if(!strcmp(argv[i], "-s") && !(statsFile = fopen(argv[i + 1], "w"))){
+			fprintf(stderr, "can't write %s\n", argv[i + 1]);
+			return 1;
+		}
+	}
+	//without a node limit the depth defaults to 6, with one alone the search goes as deep as the nodes allow
+	if(!depth_given && limits.nodes <= 0)
+		limits.depth = 6;
+	if(jobs < 1)
+		jobs = 1;
+	if(limits.depth < 1 || limits.depth > MAX_PLY)
+		limits.depth = MAX_PLY;
+
+	std::ifstream file;
+	if(strcmp(argv[1], "-")){
+		file.open(argv[1]);
+		if(!file){
+			fprintf(stderr, "can't open %s\n", argv[1]);
+			return 1;
+		}
+	}
+	std::istream &in = file.is_open() ? file : std::cin;
+
+	//the workers share one hash table, positions from the same game help each other. a search doesn't age it,
+	//that would evict the entries of the searches still running; it ages once per batch of jobs positions instead
+	transpositionTable.resize(hash_mb);
+	limits.new_generation = false;
+
+	JobQueue queue(4 * jobs);
+	std::vector<std::thread> workers;
+	for(int i = 0; i < jobs; ++i)
+		workers.emplace_back(worker, std::ref(queue), std::cref(limits));
+
+	auto start = std::chrono::steady_clock::now();
+	std::string line;
+	long long number = 0, pushed = 0;
+	while(std::getline(in, line)){
+		++number;
+		if(line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+			continue;
+		queue.push({number, line});
+		if(++pushed % jobs == 0)
+			transpositionTable.newSearch();
+	}
+	queue.close();
+	for(std::thread &t : workers)
+		t.join();
+
+	if(statsFile)
+		fclose(statsFile);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "%lld positions, %lld unreadable, %d jobs, %.1f s, %lld nodes, %.0f nps\n", searched.load(), failed.load(),
+			jobs, seconds, totalNodes.load(), seconds > 0 ? totalNodes / seconds : 0.0);
+	return 0;
+}
@@ -0,0 +1,118 @@
+#include "eval.h"
+#include<cstdlib>
+
+#define PHASE_MAX 24		//phase of the starting material: 1 per knight and bishop, 2 per rook, 4 per queen
+#define FILE_A 0x0101010101010101ULL
+
+//a middlegame and an endgame score in one int, eg in the high half, so both are summed by one add
+constexpr int S(int mg, int eg){
+	return (int)((unsigned)eg << 16) + mg;
+}
+static int mgScore(int s){
+	return (int16_t)(uint16_t)(unsigned)s;
+}
+static int egScore(int s){
+	return (int16_t)(uint16_t)((unsigned)(s + 0x8000) >> 16);
+}
+
+//indexed by piece type (pawn_w ... king_w)
+static constexpr int pieceValues[7] = {0, S(82, 94), S(477, 512), S(337, 281), S(365, 297), S(1025, 936), 0};
+static constexpr int mobilityWeights[7] = {0, 0, S(2, 4), S(4, 4), S(5, 5), S(1, 2), 0};
+static constexpr int mobilityAverage[7] = {0, 0, 7, 4, 6, 13, 0};		//moves that score 0
+static constexpr int passedBonus[8] = {0, S(5, 10), S(10, 20), S(15, 30), S(30, 55), S(55, 95), S(90, 150), 0};	//by rank from the own side
+static constexpr int doubledPenalty = S(-10, -20), isolatedPenalty = S(-10, -15);
+
+//0 on the four centre squares, 6 in the corners
+static constexpr int centreDistance(int sq){
+	int file = sq & 7, rank = sq >> 3;
+	return (file < 4 ? 3 - file : file - 4) + (rank < 4 ? 3 - rank : rank - 4);
+}
+
+//where a white piece of the type stands well (a1 = 0): pawns forward and in the centre, minor pieces and the queen central,
+//rooks on the 7th, the king tucked away in the middlegame and central in the endgame
+static constexpr int squareBonus(int type, int sq){
+	int file = sq & 7, rank = sq >> 3, centre = centreDistance(sq);
+	bool central_file = file == 3 || file == 4;
+	switch(type){
+		case pawn_w:
+			if(rank == 0 || rank == 7)
+				return 0;
+			return S(4 * (rank - 1) + (central_file ? 6 * (rank < 4 ? rank - 1 : 3) : 0), 10 * (rank - 1));
+		case knight_w: return S(15 - 6 * centre, 10 - 5 * centre);
+		case bishop_w: return S(8 - 3 * centre, 6 - 3 * centre);
+		case rook_w: return S((rank == 6 ? 20 : 0) + (central_file ? 5 : 0), rank == 6 ? 15 : 0);
+		case queen_w: return S(4 - 2 * centre, 10 - 4 * centre);
+		case king_w:{
+			int mg = rank == 0 ? (file == 1 || file == 2 || file == 6 ? 20 : file == 0 || file == 7 ? 10 : 0)
+					: rank == 1 ? -10 : -20 - 10 * (rank < 4 ? rank : 4);
+			return S(mg, 20 - 10 * centre);
+		}
+	}
+	return 0;
+}
+
+static constexpr PstTable makePstTable(){
+	PstTable table = {};
+	for(int type = pawn_w; type <= king_w; ++type){
+		for(int sq = 0; sq < 64; ++sq){
+			table.values[(6 + type) * 64 + sq] = pieceValues[type] + squareBonus(type, sq);
+			table.values[(6 - type) * 64 + sq] = -(pieceValues[type] + squareBonus(type, sq ^ 56));
+		}
+	}
+	return table;
+}
+constexpr PstTable pst = makePstTable();
+
+//moves of the knights, bishops, rooks and queens of one side to squares that aren't their own or covered by an enemy pawn
+static int mobility(Board &board, bool white){
+	int c = white ? 1 : -1;
+	Bitboard occupied = board.occupied(), own = white ? board.whitePieces : board.blackPieces;
+	Bitboard enemy_pawns = board.bitboard((Piece)(-c * pawn_w));
+	Bitboard covered = white ? ((enemy_pawns >> 7) & ~FILE_A) | ((enemy_pawns >> 9) & ~(FILE_A << 7))
+							: ((enemy_pawns << 9) & ~FILE_A) | ((enemy_pawns << 7) & ~(FILE_A << 7));
+	Bitboard allowed = ~own & ~covered;
+
+	int score = 0;
+	for(int type = rook_w; type <= queen_w; ++type){
+		for(Bitboard pieces = board.bitboard((Piece)(c * type)); pieces; ){
+			int sq = popLsb(pieces);
+			Bitboard attacks = type == knight_w ? knightAttacks(sq) : type == bishop_w ? bishopAttacks(sq, occupied)
+							: type == rook_w ? rookAttacks(sq, occupied) : queenAttacks(sq, occupied);
+			score += mobilityWeights[type] * (popCount(attacks & allowed) - mobilityAverage[type]);
+		}
+	}
+	return score;
+}
+
+static int pawnStructure(Board &board, bool white){
+	int c = white ? 1 : -1;
+	Bitboard own = board.bitboard((Piece)(c * pawn_w)), enemy = board.bitboard((Piece)(-c * pawn_w));
+
+	int score = 0;
+	for(Bitboard pawns = own; pawns; ){
+		int sq = popLsb(pawns);
+		int file = sq & 7, rank = sq >> 3;
+		Bitboard file_mask = FILE_A << file;
+		Bitboard adjacent = (file > 0 ? FILE_A << (file - 1) : 0) | (file < 7 ? FILE_A << (file + 1) : 0);
+		Bitboard ahead = white ? ~0ULL << 8 * (rank + 1) : (1ULL << 8 * rank) - 1;		//pawns stand on ranks 2-7, so the shifts stay below 64
+
+		if(!(own & adjacent))
+			score += isolatedPenalty;
+		if(own & file_mask & ahead)		//counted for every pawn with another one in front of it
+			score += doubledPenalty;
+		if(!(enemy & (file_mask | adjacent) & ahead))
+			score += passedBonus[white ? rank : 7 - rank];
+	}
+	return score;
+}
+
+int evaluate(Board &board){
+	int score = board.getPstSum() + mobility(board, true) - mobility(board, false)
+				+ pawnStructure(board, true) - pawnStructure(board, false);
+
+	int phase = popCount(board.bitboard(knight_w) | board.bitboard(knight_b) | board.bitboard(bishop_w) | board.bitboard(bishop_b))
+				+ 2 * popCount(board.bitboard(rook_w) | board.bitboard(rook_b)) + 4 * popCount(board.bitboard(queen_w) | board.bitboard(queen_b));
+	if(phase > PHASE_MAX)
+		phase = PHASE_MAX;
+	return (mgScore(score) * phase + egScore(score) * (PHASE_MAX - phase)) / PHASE_MAX;
+}
@@ -0,0 +1,21 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "chess.h"
+
+//value plus square bonus of every piece on every square, as packed middlegame and endgame scores (mgScore/egScore in
+//eval.cpp), indexed by (Piece + 6) * 64 + square, black negative and mirrored. Board::set keeps Board::psq as their sum
+struct PstTable{
+	int values[13 * 64];
+};
+extern const PstTable pst;
+
+inline int pstValue(Piece p, int sq){
+	return pst.values[(p + 6) * 64 + sq];
+}
+
+//static evaluation in centipawns, white positive: material and piece square tables tapered from middlegame to endgame
+//by the pieces left, mobility, and pawn structure (doubled, isolated and passed pawns)
+int evaluate(Board &board);
+
+#endif
@@ -0,0 +1,207 @@
+/* Load generator for the engine service: opens many sessions on the server's socket and has each play games
+	(a few random opening moves, then the engine against itself) for a fixed time, then prints the moves per second,
+	the move latency seen by the clients, how evenly the sessions were served and the server's own stats line.
+	build: g++ -O2 -pthread loadgen.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp -o loadgen
+	usage: loadgen [-s socket] [-c sessions] [-d seconds] [-m movetime] [-b clock_ms] [-i inc_ms]
+	with -b the sessions play on a clock (go without movetime), otherwise every go asks for -m ms
+*/
+#include "chess.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<mutex>
+#include<random>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<unistd.h>
+
+#define RANDOM_PLIES 6		//random opening moves, so the sessions don't all play the same game
+#define MAX_GAME_PLIES 200	//longer games are abandoned as drawn
+
+struct Connection{
+	int fd = -1;
+	std::string buffer;
+
+	bool open(const std::string &path){
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		return fd >= 0 && connect(fd, (sockaddr *)&address, sizeof(address)) == 0;
+	}
+	~Connection(){
+		if(fd >= 0)
+			close(fd);
+	}
+	bool send(const std::string &line){
+		std::string out = line + "\n";
+		for(size_t sent = 0; sent < out.size(); ){
+			ssize_t n = ::send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+			if(n <= 0)
+				return false;
+			sent += n;
+		}
+		return true;
+	}
+	bool readLine(std::string &line){
+		size_t end;
+		char chunk[4096];
+		while((end = buffer.find('\n')) == std::string::npos){
+			ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+			if(n <= 0)
+				return false;
+			buffer.append(chunk, n);
+		}
+		line = buffer.substr(0, end);
+		buffer.erase(0, end + 1);
+		return true;
+	}
+	//sends a command and reads its answer, false if the connection broke or the answer is an error
+	bool command(const std::string &line, std::string &answer){
+		return send(line) && readLine(answer) && answer.compare(0, 6, "error ") != 0;
+	}
+};
+
+struct Settings{
+	std::string path = "/tmp/chess.sock";
+	int seconds = 10, movetime = 100, clock = 0, inc = 0;
+};
+
+struct SessionResult{
+	std::vector<int> latencies;		//ms from sending go to reading bestmove
+	int games = 0;
+	bool failed = false;
+	std::string error;
+};
+
+void playSession(const Settings &settings, int id, Clock::time_point deadline, SessionResult &result){
+	Connection c;
+	if(!c.open(settings.path)){
+		result.failed = true;
+		result.error = "can't connect to " + settings.path;
+		return;
+	}
+
+	std::mt19937 rng(id * 7919 + 1);
+	std::string answer;
+	std::string go = settings.clock ? "go" : "go movetime " + std::to_string(settings.movetime);
+	while(Clock::now() < deadline){
+		//a new game, with its own clock
+		Board board;
+		if(!c.command("position startpos", answer) || (settings.clock
+				&& !c.command("clock " + std::to_string(settings.clock) + " " + std::to_string(settings.inc), answer))){
+			result.failed = true;
+			result.error = answer;
+			return;
+		}
+
+		for(int ply = 0; ply < MAX_GAME_PLIES && Clock::now() < deadline; ++ply){
+			Move m;
+			if(ply < RANDOM_PLIES){
+				MoveList moves;
+				generateLegalMoves(board, moves);
+				if(moves.empty())
+					break;
+				m = moves[std::uniform_int_distribution<int>(0, moves.size() - 1)(rng)];
+			} else {
+				Clock::time_point sent = Clock::now();
+				if(!c.command(go, answer)){
+					result.failed = true;
+					result.error = answer;
+					return;
+				}
+				result.latencies.push_back((int)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - sent).count());
+				std::istringstream in(answer);
+				std::string token, move;
+				in >> token >> move;
+				m = parseMove(board, move);
+				if(m == Move())
+					break;		//mate or stalemate
+			}
+			playMove(board, m);
+			if(!c.command("move " + moveToString(m), answer)){
+				result.failed = true;
+				result.error = answer;
+				return;
+			}
+		}
+		++result.games;
+	}
+	c.send("quit");
+}
+
+int percentile(std::vector<int> &sorted, int percent){
+	return sorted.empty() ? 0 : sorted[(sorted.size() - 1) * percent / 100];
+}
+
+int main(int argc, char *argv[]){
+	Settings settings;
+	int sessions = 16;
+
+	for(int i = 1; i < argc; ++i){
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if(arg == "-s" && has_value)
+			settings.path = argv[++i];
+		else if(arg == "-c" && has_value)
+			sessions = atoi(argv[++i]);
+		else if(arg == "-d" && has_value)
+			settings.seconds = atoi(argv[++i]);
+		else if(arg == "-m" && has_value)
+			settings.movetime = atoi(argv[++i]);
+		else if(arg == "-b" && has_value)
+			settings.clock = atoi(argv[++i]);
+		else if(arg == "-i" && has_value)
+			settings.inc = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-s socket] [-c sessions] [-d seconds] [-m movetime] [-b clock_ms] [-i inc_ms]\n", argv[0]);
+			return 1;
+		}
+	}
+	sessions = std::max(sessions, 1);
+
+	printf("%d sessions for %d s, %s\n", sessions, settings.seconds, settings.clock
+			? ("clock " + std::to_string(settings.clock) + "+" + std::to_string(settings.inc) + " ms").c_str()
+			: ("movetime " + std::to_string(settings.movetime) + " ms").c_str());
+	Clock::time_point start = Clock::now(), deadline = start + std::chrono::seconds(settings.seconds);
+	std::vector<SessionResult> results(sessions);
+	std::vector<std::thread> threads;
+	for(int i = 0; i < sessions; ++i)
+		threads.emplace_back(playSession, std::cref(settings), i, deadline, std::ref(results[i]));
+	for(auto &t : threads)
+		t.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::vector<int> all;
+	int games = 0, failed = 0, least = -1, most = 0;
+	for(SessionResult &r : results){
+		if(r.failed){
+			if(!failed)
+				fprintf(stderr, "session failed: %s\n", r.error.c_str());
+			++failed;
+		}
+		all.insert(all.end(), r.latencies.begin(), r.latencies.end());
+		games += r.games;
+		least = least < 0 ? (int)r.latencies.size() : std::min(least, (int)r.latencies.size());
+		most = std::max(most, (int)r.latencies.size());
+	}
+	std::sort(all.begin(), all.end());
+
+	printf("moves %d (%.1f/s) in %d games, failed sessions %d\n", (int)all.size(), all.size() / elapsed, games, failed);
+	printf("latency p50 %d ms p99 %d ms max %d ms\n", percentile(all, 50), percentile(all, 99), all.empty() ? 0 : all.back());
+	printf("moves per session min %d max %d\n", least, most);
+
+	Connection c;
+	std::string answer;
+	if(c.open(settings.path) && c.command("stats", answer))
+		printf("server: %s\n", answer.c_str());
+	c.send("quit");
+	return failed ? 1 : 0;
+}
@@ -1,12 +1,21 @@
 #include <windows.h>
 #include<gdiplus.h>
+#include "book.h"
 #include "chess.h"
 #include "resource.h"
 #define DISPLAY_SIZE 640
 #define MINIMAX_DEPTH 5
+#define COMPUTER_MOVE_TIME 3000		//ms, the search stops at this or MINIMAX_DEPTH
+#define BOOK_FILE "book.bin"		//polyglot book next to the exe, optional
+#define SEARCH_TIMER 1
+#define SEARCH_POLL 20				//ms between looks at whether the computer's search has finished
 
 //GLOBAL VARIABLES
 Board board;
+Book book;
+SearchSession session;		//the computer thinks here while the window keeps handling messages
+std::future<SearchInfo> searchResult;
+Move expectedReply = Move();		//the player's move the session is pondering on, Move() when it isn't
 Coordinate movedPosition, activePosition;
 CoordinateList validMoves;
 bool isComputerTurn = false, isGameOver = false;
@@ -19,7 +28,8 @@ LPCWSTR getImageDir(Piece piece);
 void printBoard(HWND hwnd);
 void onClickCell(int x, int y);
 Piece getPromotionPiece(const Coordinate &c, Board &board, int depth);
-void doComputerMove();
+void startComputerMove();
+void finishComputerMove(Move m, Move reply);
 void doPlayerMove(const Coordinate& move);
 bool hasValidMoves(Piece color);
 void finishGame();
@@ -35,6 +45,8 @@ int WINAPI WinMain(HINSTANCE currentInstance, HINSTANCE previousInstance, PSTR c
 	ULONG_PTR gdiplusToken;
 	Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, nullptr);
 
+	book.open(BOOK_FILE);
+
 	// Register the window class
 	WNDCLASSA wc{};
 	wc.hInstance = currentInstance;
@@ -75,10 +87,13 @@ LRESULT CALLBACK WindowProcessMessages(HWND hwnd, UINT msg, WPARAM param, LPARAM
 
 	switch (msg) {
 	case WM_DESTROY:{
+		session.stop();
 		PostQuitMessage(0);		//makes GetMessage return 0 (and this the window loop exits)
 		return 0;
 	}
 	case WM_LBUTTONDOWN:{
+		if(isComputerTurn)
+			return 0;
 		int posX = lparam & 0xffff, posY = (lparam >> 16) & 0xffff;
 		onClickCell(BOARD_SIZE*posX/DISPLAY_SIZE, BOARD_SIZE*posY/DISPLAY_SIZE);
 		RedrawWindow(hwnd, NULL, NULL, RDW_INVALIDATE);
@@ -90,9 +105,13 @@ LRESULT CALLBACK WindowProcessMessages(HWND hwnd, UINT msg, WPARAM param, LPARAM
 		if(isGameOver){
 			finishGame();
 		}
-		//do computer move after player move is printed
-		if(isComputerTurn){
-			doComputerMove();
+		return 0;
+	}
+	case WM_TIMER:{
+		if(param == SEARCH_TIMER && searchResult.valid() && searchResult.wait_for(std::chrono::seconds(0)) == std::future_status::ready){
+			KillTimer(hwnd, SEARCH_TIMER);
+			SearchInfo info = searchResult.get();
+			finishComputerMove(info.move, info.pv_length > 1 ? info.pv[1] : Move());
 			RedrawWindow(hwnd, NULL, NULL, RDW_INVALIDATE);
 		}
 		return 0;
@@ -224,28 +243,28 @@ Piece getPromotionPiece(){
 	return empty;
 }
 
-/* shitty solution but it works
-	getMoveToMake() returns promoted to piece if promoted
-	movePiece() needs function to get promotion option
-	so assign the return value to a global var and return that as required
-*/
-Piece computer_promoted;
-Piece getComputerPromotion(){
-	return computer_promoted;
+SearchLimits computerLimits(){
+	SearchLimits limits;
+	limits.depth = MINIMAX_DEPTH;
+	limits.movetime = COMPUTER_MOVE_TIME;
+	return limits;
+}
+
+//in book the move is played straight away, otherwise the search starts and WM_TIMER picks up its move
+void startComputerMove(){
+	Move book_move = book.probe(board);
+	if(book_move != Move()){
+		finishComputerMove(book_move, Move());
+		return;
+	}
+	searchResult = session.start(board, computerLimits());
+	SetTimer(hwnd, SEARCH_TIMER, SEARCH_POLL, NULL);
 }
 
-void doComputerMove(){
-	Coordinate comp_from, comp_to;
-	computer_promoted = getMoveToMake(comp_from, comp_to, board, MINIMAX_DEPTH, -1);
-	movePiece(board, comp_from, comp_to, getComputerPromotion);
-	int to_x;
-	if(comp_to.x == INFINITY_NUM)
-		to_x = 6;
-	else if(comp_to.x == -INFINITY_NUM)
-		to_x = 2;
-	else
-		to_x = comp_to.x;
-	movedPosition.set(to_x, comp_to.y);
+//reply: the player's answer the search expects, pondered on till the player moves
+void finishComputerMove(Move m, Move reply){
+	playMove(board, m);
+	movedPosition.set(squareX(m.to()), squareY(m.to()));
 	isComputerTurn = false;
 
 	//check for game end
@@ -261,6 +280,14 @@ void doComputerMove(){
 		winner = king_w;
 		isGameOver = true;
 	}
+
+	expectedReply = Move();
+	if(!isGameOver && reply != Move()){
+		Board pondered = board;
+		playMove(pondered, reply);
+		searchResult = session.start(pondered, computerLimits(), true);
+		expectedReply = reply;
+	}
 }
 
 void doPlayerMove(const Coordinate& move){
@@ -277,6 +304,17 @@ void doPlayerMove(const Coordinate& move){
 		}
 		isGameOver = true;
 	}
+
+	//the computer answers at once if it has been thinking about this move, else it starts over
+	if(isGameOver){
+		session.stop();
+	} else if(expectedReply != Move() && board.undoStack[board.undoSize - 1].move == expectedReply){
+		session.ponderhit();
+		SetTimer(hwnd, SEARCH_TIMER, SEARCH_POLL, NULL);
+	} else {
+		startComputerMove();
+	}
+	expectedReply = Move();
 }
 
 bool hasValidMoves(Piece color){
@@ -301,6 +339,9 @@ void finishGame(){
 	LPCSTR message = (winner == empty)?"It's a tie!" : (winner == king_w) ?"You Win!" : "Better luck next time.";
 	//show dialog
 	if(MessageBoxA(hwnd, message, "Game Over", MB_RETRYCANCEL) == IDRETRY){
+		session.stop();
+		KillTimer(hwnd, SEARCH_TIMER);
+		expectedReply = Move();
 		board = Board();
 		isComputerTurn = false;
 		validMoves.clear();
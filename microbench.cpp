@@ -0,0 +1,251 @@
+/* Microbenchmarks of the board primitives over a fixed set of middlegame and endgame positions.
+	each line is the median of several timed samples, in ns and heap allocations per call
+	build: g++ -O2 -pthread microbench.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp alloc_counter.cpp -o microbench
+	usage: microbench [filter] [ms_per_benchmark]		(only benchmarks whose name contains filter are run)
+*/
+#include "alloc_counter.h"
+#include "chess.h"
+#include "endgame.h"
+#include "eval.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<string>
+#include<vector>
+
+#define SAMPLES 5
+
+const char *middlegames[] = {
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+	"r2q1rk1/pp2ppbp/2p2np1/6B1/3PP1b1/Q1P2N2/P4PPP/3RKB1R b K - 0 13",
+	"r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+	"2rq1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PNBPN2/PB2QPPP/2RR2K1 w - - 0 13",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+};
+const char *endgames[] = {
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+	"8/5pk1/6p1/7p/P7/1P4PP/5PK1/8 w - - 0 40",
+	"4r1k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+	"8/8/8/3k4/8/8/3K4/3R4 w - - 0 1",
+	"8/8/8/4k3/8/8/4P3/4K3 b - - 0 1",
+};
+
+volatile uint64_t sink;		//results go here so the compiler can't drop the work
+std::vector<Board> corpus;
+std::vector<MoveList> corpusMoves;		//legal moves of each position, generated once
+std::string filter;
+int msPerBenchmark = 250;
+
+//runs round() (which returns the calls it made) till the sample time is used up, SAMPLES times, and prints the medians
+template<class Round>
+void bench(const std::string &name, Round round){
+	if(name.find(filter) == std::string::npos)
+		return;
+	round();		//warm up
+	double ns[SAMPLES], allocs[SAMPLES];
+	for(int s = 0; s < SAMPLES; ++s){
+		long long calls = 0, allocs_before = allocations;
+		auto start = std::chrono::steady_clock::now();
+		double elapsed;
+		do {
+			calls += round();
+			elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		} while(elapsed < msPerBenchmark * 1e6 / SAMPLES);
+		ns[s] = elapsed / calls;
+		allocs[s] = (double)(allocations - allocs_before) / calls;
+	}
+	std::sort(ns, ns + SAMPLES);
+	std::sort(allocs, allocs + SAMPLES);
+	printf("%-40s %12.1f %12.2f\n", name.c_str(), ns[SAMPLES / 2], allocs[SAMPLES / 2]);
+}
+
+const char *pieceNames[] = {"", "pawn", "rook", "knight", "bishop", "queen", "king"};
+
+int main(int argc, char *argv[]){
+	filter = argc > 1 ? argv[1] : "";
+	if(argc > 2)
+		msPerBenchmark = atoi(argv[2]);
+
+	for(const char *fen : middlegames){
+		corpus.emplace_back();
+		corpus.back().setFen(fen);
+	}
+	for(const char *fen : endgames){
+		corpus.emplace_back();
+		corpus.back().setFen(fen);
+	}
+	for(Board &b : corpus){
+		corpusMoves.emplace_back();
+		generateLegalMoves(b, corpusMoves.back());
+	}
+	printf("%d positions, %d ms per benchmark\n", (int)corpus.size(), msPerBenchmark);
+	printf("%-40s %12s %12s\n", "benchmark", "ns/op", "allocs/op");
+
+	bench("generateLegalMoves", []{
+		for(Board &b : corpus){
+			MoveList moves;
+			generateLegalMoves(b, moves);
+			sink += moves.size();
+		}
+		return (long long)corpus.size();
+	});
+	bench("generateLegal captures", []{
+		for(Board &b : corpus){
+			MoveList moves;
+			generateLegal(b, b.turn == 1, ~0ULL, moves, true);
+			sink += moves.size();
+		}
+		return (long long)corpus.size();
+	});
+
+	//per piece type, the side to move's pieces of that type
+	for(int type = pawn_w; type <= king_w; ++type){
+		bench(std::string("generatePieceMoves ") + pieceNames[type], [type]{
+			long long calls = 0;
+			for(Board &b : corpus){
+				for(Bitboard pieces = b.bitboard((Piece)(type * b.turn)); pieces; ++calls){
+					MoveList moves;
+					generatePieceMoves(b, popLsb(pieces), moves);
+					sink += moves.size();
+				}
+			}
+			return calls;
+		});
+		for(int removeInvalid = 0; removeInvalid < 2; ++removeInvalid){
+			bench(std::string("getMoves ") + pieceNames[type] + (removeInvalid ? " legal" : " pseudo"), [type, removeInvalid]{
+				long long calls = 0;
+				for(Board &b : corpus){
+					for(Bitboard pieces = b.bitboard((Piece)(type * b.turn)); pieces; ++calls){
+						int sq = popLsb(pieces);
+						CoordinateList moves;
+						getMoves(moves, Coordinate(squareX(sq), squareY(sq)), b, removeInvalid);
+						sink += moves.size();
+					}
+				}
+				return calls;
+			});
+		}
+	}
+
+	bench("isInCheck", []{
+		for(Board &b : corpus)
+			sink += isInCheck(b.turn == 1 ? king_w : king_b, b);
+		return (long long)corpus.size();
+	});
+	bench("isSquareAttacked (all squares)", []{
+		for(Board &b : corpus){
+			for(int sq = 0; sq < 64; ++sq)
+				sink += isSquareAttacked(b, sq, b.turn != 1);
+		}
+		return (long long)corpus.size() * 64;
+	});
+	bench("Board::find", []{
+		for(Board &b : corpus)
+			sink += b.find(king_w).x + b.find(queen_b).y;
+		return (long long)corpus.size() * 2;
+	});
+	bench("Board::getPstSum", []{
+		for(Board &b : corpus)
+			sink += b.getPstSum();
+		return (long long)corpus.size();
+	});
+	bench("Board::computeKey", []{
+		for(Board &b : corpus)
+			sink += b.computeKey();
+		return (long long)corpus.size();
+	});
+
+	//every legal move of every position, made and taken back
+	bench("makeMove + unmakeMove", []{
+		long long calls = 0;
+		for(size_t i = 0; i < corpus.size(); ++i){
+			Board &b = corpus[i];
+			MoveList &moves = corpusMoves[i];
+			for(Move m : moves){
+				b.makeMove(m);
+				sink += b.key;
+				b.unmakeMove();
+			}
+			calls += moves.size();
+		}
+		return calls;
+	});
+	bench("playMove + unmakeMove", []{
+		long long calls = 0;
+		for(size_t i = 0; i < corpus.size(); ++i){
+			Board &b = corpus[i];
+			MoveList &moves = corpusMoves[i];
+			for(Move m : moves){
+				playMove(b, m);
+				sink += b.warnedPosition.x;
+				b.unmakeMove();
+			}
+			calls += moves.size();
+		}
+		return calls;
+	});
+
+	//the gui's path: coordinates in, promotion piece from a callback
+	static Board castling, promotion;
+	castling.setFen("r3k2r/pppppppp/8/8/8/8/PPPPPPPP/R3K2R w KQkq - 0 1");
+	promotion.setFen("1k6/6P1/8/8/8/8/8/K7 w - - 0 1");
+	bench("movePiece castling", []{
+		movePiece(castling, Coordinate(4, 7), Coordinate(INFINITY_NUM, 7), nullptr);
+		castling.unmakeMove();
+		movePiece(castling, Coordinate(4, 7), Coordinate(-INFINITY_NUM, 7), nullptr);
+		castling.unmakeMove();
+		sink += castling.key;
+		return 2LL;
+	});
+	bench("movePiece promotion", []{
+		movePiece(promotion, Coordinate(6, 1), Coordinate(6, 0), []{ return knight_w; });
+		promotion.unmakeMove();
+		sink += promotion.key;
+		return 1LL;
+	});
+
+	bench("moveToString + parseMove", []{
+		long long calls = 0;
+		for(size_t i = 0; i < corpus.size(); ++i){
+			Board &b = corpus[i];
+			MoveList &moves = corpusMoves[i];
+			for(Move m : moves)
+				sink += parseMove(b, moveToString(m)).data;
+			calls += moves.size();
+		}
+		return calls;
+	});
+	bench("Board::getFen", []{
+		for(Board &b : corpus)
+			sink += b.getFen().size();
+		return (long long)corpus.size();
+	});
+	bench("Board::setFen", []{
+		Board b;
+		for(const char *fen : middlegames)
+			sink += b.setFen(fen);
+		return (long long)(sizeof(middlegames) / sizeof(*middlegames));
+	});
+	bench("evaluate", []{
+		for(Board &b : corpus)
+			sink += evaluate(b);
+		return (long long)corpus.size();
+	});
+	bench("Board::computePstSum", []{
+		for(Board &b : corpus)
+			sink += b.computePstSum();
+		return (long long)corpus.size();
+	});
+	bench("probeEndgame", []{
+		int score;
+		for(Board &b : corpus)
+			sink += probeEndgame(b, 0, score) ? score : 0;
+		return (long long)corpus.size();
+	});
+	return 0;
+}
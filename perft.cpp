@@ -0,0 +1,195 @@
+/* Headless perft driver: counts the leaf nodes generateLegalMoves + makeMove reach from a position.
+	build: g++ -O2 -pthread perft.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp -o perft
+	usage: perft <depth> [-fen "<fen>"] [-t threads] [-H hash_mb]		node count per root move, from the start position by default
+	       perft suite [-t threads] [-H hash_mb]					the standard test positions against known counts
+	en passant isn't implemented, so the counts leave out en passant captures and everything after them. They match the
+	published ones only where no en passant capture is possible within the depth: from the start position depth 5 gives
+	4865351 (published 4865609) and depth 6 gives 119048441 (published 119060324)
+*/
+#include "chess.h"
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<thread>
+#include<vector>
+
+struct RootMove{
+	Move move;
+	long long nodes;
+};
+
+//the usual perft test positions. nodes is what this engine must count, published the count of a full move generator
+//(they differ where en passant captures are possible)
+struct SuitePosition{
+	const char *name, *fen;
+	int depth;
+	long long nodes, published;
+};
+const SuitePosition suite[] = {
+	{"start", START_FEN, 5, 4865351, 4865609},
+	{"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4079596, 4085603},
+	{"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 671300, 674624},
+	{"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422146, 422333},
+	{"position 4 mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 4, 422146, 422333},
+	{"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487, 2103487},
+	{"position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594, 3894594},
+};
+
+//shared node count cache, entries are verified by storing key ^ data so threads need no locks
+struct PerftEntry{
+	std::atomic<uint64_t> check, data;
+};
+
+PerftEntry *hashTable = nullptr;
+uint64_t hashMask = 0;
+
+uint64_t zobristDepth[64];
+
+void initZobrist(){
+	uint64_t seed = 0x9E3779B97F4A7C15ULL;
+	auto next = [&seed](){
+		seed ^= seed >> 12;
+		seed ^= seed << 25;
+		seed ^= seed >> 27;
+		return seed * 2685821657736338717ULL;
+	};
+	for(auto &k : zobristDepth)
+		k = next();
+}
+
+long long perft(Board &board, int depth){
+	MoveList moves;
+	generateLegalMoves(board, moves);
+	if(depth == 1)
+		return moves.size();	//bulk count at the last ply
+
+	uint64_t key = 0;
+	if(hashTable){
+		key = board.key ^ zobristDepth[depth];
+		PerftEntry &e = hashTable[key & hashMask];
+		uint64_t data = e.data.load(std::memory_order_relaxed);
+		if((e.check.load(std::memory_order_relaxed) ^ data) == key)
+			return data;
+	}
+
+	long long nodes = 0;
+	for(Move m : moves){
+		board.makeMove(m);
+		nodes += perft(board, depth - 1);
+		board.unmakeMove();
+	}
+
+	if(hashTable){
+		PerftEntry &e = hashTable[key & hashMask];
+		e.check.store(key ^ (uint64_t)nodes, std::memory_order_relaxed);
+		e.data.store(nodes, std::memory_order_relaxed);
+	}
+	return nodes;
+}
+
+//perft from board with the root moves handed out one at a time to the threads, root gets the count of each when given
+long long countNodes(Board &board, int depth, int threads, std::vector<RootMove> *root){
+	MoveList moves;
+	generateLegalMoves(board, moves);
+	std::vector<RootMove> counts;
+	for(Move m : moves)
+		counts.push_back({m, 1});
+
+	std::atomic<size_t> nextMove(0);
+	auto worker = [&](){
+		for(size_t i; (i = nextMove++) < counts.size(); ){
+			if(depth == 1)
+				continue;
+			Board next = board;
+			next.makeMove(counts[i].move);
+			counts[i].nodes = perft(next, depth - 1);
+		}
+	};
+	std::vector<std::thread> pool;
+	for(int i = 0; i < threads; ++i)
+		pool.emplace_back(worker);
+	for(auto &t : pool)
+		t.join();
+
+	long long total = 0;
+	for(auto &m : counts)
+		total += m.nodes;
+	if(root)
+		*root = counts;
+	return total;
+}
+
+int main(int argc, char *argv[]){
+	if(argc < 2){
+		printf("usage: %s <depth> [-fen \"<fen>\"] [-t threads] [-H hash_mb]\n       %s suite [-t threads] [-H hash_mb]\n", argv[0], argv[0]);
+		return 1;
+	}
+	int depth = strcmp(argv[1], "suite") ? atoi(argv[1]) : 1;
+	int threads = std::thread::hardware_concurrency();
+	long long hash_mb = 0;
+	std::string fen = START_FEN;
+	for(int i = 2; i + 1 < argc; i += 2){
+		if(!strcmp(argv[i], "-t"))
+			threads = atoi(argv[i + 1]);
+		else if(!strcmp(argv[i], "-H"))
+			hash_mb = atoll(argv[i + 1]);
+		else if(!strcmp(argv[i], "-fen"))
+			fen = argv[i + 1];
+	}
+	if(depth < 1 || depth >= 64){
+		printf("depth must be between 1 and 63\n");
+		return 1;
+	}
+	if(threads < 1)
+		threads = 1;
+
+	if(hash_mb > 0){
+		initZobrist();
+		uint64_t entries = 1;
+		while(entries * 2 * sizeof(PerftEntry) <= (uint64_t)hash_mb << 20)
+			entries *= 2;
+		hashTable = new PerftEntry[entries];
+		for(uint64_t i = 0; i < entries; ++i){
+			hashTable[i].check = 0;
+			hashTable[i].data = 0;
+		}
+		hashMask = entries - 1;
+	}
+
+	if(!strcmp(argv[1], "suite")){
+		bool ok = true;
+		printf("%-20s %6s %12s %12s %8s\n", "position", "depth", "nodes", "expected", "time (s)");
+		for(const SuitePosition &p : suite){
+			Board board;
+			board.setFen(p.fen);
+			auto start = std::chrono::steady_clock::now();
+			long long nodes = countNodes(board, p.depth, threads, nullptr);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("%-20s %6d %12lld %12lld %8.3f %s", p.name, p.depth, nodes, p.nodes, seconds, nodes == p.nodes ? "ok" : "FAIL");
+			if(p.published != p.nodes)
+				printf("  (published %lld, with en passant)", p.published);
+			printf("\n");
+			ok = ok && nodes == p.nodes;
+		}
+		return ok ? 0 : 1;
+	}
+
+	Board board;
+	if(!board.setFen(fen)){
+		printf("invalid fen %s\n", fen.c_str());
+		return 1;
+	}
+
+	std::vector<RootMove> root;
+	auto start = std::chrono::steady_clock::now();
+	long long total = countNodes(board, depth, threads, &root);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for(auto &m : root)
+		printf("%s: %lld\n", moveToString(m.move).c_str(), m.nodes);
+	printf("\nNodes: %lld\nTime: %.3f s\nNPS: %.0f\n", total, seconds, seconds > 0 ? total / seconds : 0.0);
+	return 0;
+}
@@ -0,0 +1,457 @@
+/* Engine against engine tournament: two search settings, A and B, play every opening with both colors,
+	one game per worker thread. Games are written to a PGN file as they finish, and an Elo estimate
+	(with an optional SPRT) of A against B is printed at the end.
+	build: g++ -O2 -pthread selfplay.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp -o selfplay
+	usage: selfplay [-A settings] [-B settings] [-r rounds] [-j jobs] [-H hash_mb] [-openings file] [-pgn file] [-sprt elo0 elo1]
+	settings are comma separated, e.g. "depth=5" or "nodes=20000,qs=0" or "movetime=100":
+		depth=N, nodes=N, movetime=ms (per move limits), qs=0|1 (quiescence), name=text,
+		pvs=0|1, aspiration=0|1, nullmove=0|1, lmr=0|1 (search techniques, all on by default)
+	a player needs at least one of depth, nodes and movetime
+	the openings file has one position per line, either a FEN or moves from the start position ("e2e4 e7e5")
+	each player has a hash table of its own (-H MB) in every game, cleared when the game starts, so depth and node limited
+	matches play the same games whatever the number of jobs
+*/
+#include "chess.h"
+#include "tt.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<ctime>
+#include<fstream>
+#include<mutex>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+
+//used without an openings file, each is played twice with the colors swapped
+const char *defaultOpenings[] = {
+	"e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",
+	"e2e4 e7e5 g1f3 b8c6 f1c4 f8c5",
+	"e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6",
+	"e2e4 c7c5 b1c3 b8c6 g2g3 g7g6",
+	"e2e4 e7e6 d2d4 d7d5 b1c3 g8f6",
+	"e2e4 c7c6 d2d4 d7d5 e4e5 c8f5",
+	"e2e4 d7d5 e4d5 d8d5 b1c3 d5a5",
+	"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",
+	"d2d4 d7d5 c2c4 c7c6 g1f3 g8f6",
+	"d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6",
+	"d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",
+	"d2d4 f7f5 g2g3 g8f6 f1g2 g7g6",
+	"c2c4 e7e5 b1c3 g8f6 g1f3 b8c6",
+	"g1f3 d7d5 g2g3 g8f6 f1g2 e7e6",
+	"e2e4 g7g6 d2d4 f8g7 b1c3 d7d6",
+	"b2b3 e7e5 c1b2 b8c6 e2e3 g8f6",
+};
+
+struct Player{
+	std::string name;
+	SearchLimits limits;
+};
+
+enum Result{
+	WHITE_WINS, BLACK_WINS, DRAW
+};
+
+struct Tournament{
+	Player players[2];		//A and B
+	std::vector<std::string> openings;
+	int games;
+	int hash_mb = 16;		//per player in every game
+	std::atomic<int> next{0};
+	std::atomic<bool> stop{false};		//set once the SPRT has decided
+
+	double elo0 = 0, elo1 = 0;
+	bool sprt = false;
+
+	std::mutex mutex;		//guards everything below
+	FILE *pgn = nullptr;
+	int wins = 0, draws = 0, losses = 0;		//for A
+	int finished = 0;
+	long long plies = 0;
+};
+
+//sets up a FEN or plays moves from the start position, false if the line makes no sense
+bool setupOpening(Board &board, const std::string &opening){
+	if(opening.find('/') != std::string::npos)
+		return board.setFen(opening);
+
+	board.setFen(START_FEN);
+	std::istringstream in(opening);
+	std::string token;
+	while(in >> token){
+		Move m = parseMove(board, token);
+		if(m == Move())
+			return false;
+		playMove(board, m);
+	}
+	return true;
+}
+
+//standard algebraic notation of a legal move (Nbd7, exd5, e8=Q+, O-O), written before it is played
+std::string toSan(Board &board, Move m){
+	std::string san;
+	int from = m.from(), to = m.to();
+	Piece moving = board.state[squareX(from)][squareY(from)];
+	int type = abs(moving);
+
+	if(m.isCastle()){
+		san = m.flags() == MOVE_CASTLE_KING ? "O-O" : "O-O-O";
+	} else if(type == pawn_w){
+		if(m.isCapture()){
+			san += 'a' + squareX(from);
+			san += 'x';
+		}
+		san += moveToString(m).substr(2, 2);
+		if(m.isPromotion()){
+			san += '=';
+			san += "NBRQ"[m.flags() & 3];
+		}
+	} else {
+		san += " PRNBQK"[type];
+
+		//another piece of the same kind reaching the square has to be told apart, by file if that is enough
+		MoveList moves;
+		generateLegalMoves(board, moves);
+		bool ambiguous = false, same_file = false, same_rank = false;
+		for(Move other : moves){
+			if(other.to() != to || other.from() == from || other.isCastle() || board.state[squareX(other.from())][squareY(other.from())] != moving)
+				continue;
+			ambiguous = true;
+			same_file |= squareX(other.from()) == squareX(from);
+			same_rank |= squareY(other.from()) == squareY(from);
+		}
+		if(ambiguous && (!same_file || same_rank))
+			san += 'a' + squareX(from);
+		if(ambiguous && same_file)
+			san += '1' + (from >> 3);
+
+		if(m.isCapture())
+			san += 'x';
+		san += moveToString(m).substr(2, 2);
+	}
+
+	board.makeMove(m);
+	if(isInCheck(board.turn == 1 ? king_w : king_b, board)){
+		MoveList replies;
+		generateLegalMoves(board, replies);
+		san += replies.empty() ? '#' : '+';
+	}
+	board.unmakeMove();
+	return san;
+}
+
+//no sequence of legal moves can mate: bare kings, or a single knight or bishop left
+bool isInsufficientMaterial(Board &board){
+	Bitboard heavy = board.bitboard(pawn_w) | board.bitboard(pawn_b) | board.bitboard(rook_w) | board.bitboard(rook_b)
+					| board.bitboard(queen_w) | board.bitboard(queen_b);
+	return !heavy && popCount(board.occupied()) <= 3;
+}
+
+//writes m in the movetext and plays it
+void recordMove(Board &board, Move m, std::ostringstream &out, bool first){
+	if(board.turn == 1)
+		out << board.fullmoveNumber << ". ";
+	else if(first)
+		out << board.fullmoveNumber << "... ";
+	out << toSan(board, m) << ' ';
+	playMove(board, m);
+}
+
+//plays one game from the opening, white_player is 0 for A and 1 for B, returns the result and fills in the movetext
+//openings given as moves are part of the movetext, FEN openings go in the PGN header
+//tables holds A's and B's hash tables, neither player ever sees the other's analysis
+Result playGame(Tournament &t, const std::string &opening, int white_player, TranspositionTable tables[2], std::string &movetext, std::string &termination, int &plies){
+	Board board;
+	std::ostringstream out;
+	bool first = true;
+	plies = 0;
+	if(opening.find('/') != std::string::npos){
+		board.setFen(opening);
+	} else {
+		std::istringstream in(opening);
+		std::string token;
+		while(in >> token){
+			recordMove(board, parseMove(board, token), out, first);
+			first = false;
+		}
+	}
+
+	for(;;){
+		MoveList moves;
+		generateLegalMoves(board, moves);
+		if(moves.empty()){
+			if(isInCheck(board.turn == 1 ? king_w : king_b, board)){
+				termination = board.turn == 1 ? "Black mates" : "White mates";
+				movetext = out.str();
+				return board.turn == 1 ? BLACK_WINS : WHITE_WINS;
+			}
+			termination = "Stalemate";
+			break;
+		}
+		if(board.halfmoveClock >= 100){
+			termination = "Fifty move rule";
+			break;
+		}
+		if(board.isRepeated(2)){
+			termination = "Threefold repetition";
+			break;
+		}
+		if(isInsufficientMaterial(board)){
+			termination = "Insufficient material";
+			break;
+		}
+
+		int side = board.turn == 1 ? white_player : 1 - white_player;
+		SearchLimits limits = t.players[side].limits;
+		limits.tt = &tables[side];
+		Coordinate from, to;
+		SearchInfo info;
+		getMoveToMake(from, to, board, limits, board.turn, &info);
+		recordMove(board, info.move != Move() ? info.move : moves[0], out, first);
+		first = false;
+		++plies;
+	}
+	movetext = out.str();
+	return DRAW;
+}
+
+//Elo difference for an expected score
+double eloFromScore(double score){
+	return -400 * log10(1 / score - 1);
+}
+
+//log likelihood ratio of elo1 against elo0 for the games so far (normal approximation of the trinomial)
+double sprtLlr(int wins, int draws, int losses, double elo0, double elo1){
+	int n = wins + draws + losses;
+	if(!n)
+		return 0;
+	double score = (wins + draws / 2.0) / n;
+	double variance = (wins * pow(1 - score, 2) + draws * pow(0.5 - score, 2) + losses * pow(score, 2)) / n;
+	if(variance <= 0)
+		return 0;
+	double s0 = 1 / (1 + pow(10, -elo0 / 400)), s1 = 1 / (1 + pow(10, -elo1 / 400));
+	return (s1 - s0) * (2 * score - s0 - s1) / (2 * variance / n);
+}
+
+void writePgn(Tournament &t, int game, const std::string &opening, int white_player, Result result,
+				const std::string &movetext, const std::string &termination){
+	static const char *results[] = {"1-0", "0-1", "1/2-1/2"};
+	char date[16];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+
+	fprintf(t.pgn, "[Event \"selfplay\"]\n[Site \"?\"]\n[Date \"%s\"]\n[Round \"%d\"]\n", date, game + 1);
+	fprintf(t.pgn, "[White \"%s\"]\n[Black \"%s\"]\n[Result \"%s\"]\n", t.players[white_player].name.c_str(),
+			t.players[1 - white_player].name.c_str(), results[result]);
+	if(opening.find('/') != std::string::npos)
+		fprintf(t.pgn, "[SetUp \"1\"]\n[FEN \"%s\"]\n", opening.c_str());
+	fprintf(t.pgn, "\n");
+
+	//movetext lines are kept under 80 characters
+	std::istringstream in(movetext + "{" + termination + "} " + results[result]);
+	std::string word, line;
+	while(in >> word){
+		if(word[0] == '{'){
+			std::string rest;
+			while(word.back() != '}' && in >> rest)
+				word += " " + rest;
+		}
+		if(!line.empty() && line.size() + 1 + word.size() >= 80){
+			fprintf(t.pgn, "%s\n", line.c_str());
+			line.clear();
+		}
+		line += (line.empty() ? "" : " ") + word;
+	}
+	fprintf(t.pgn, "%s\n\n", line.c_str());
+	fflush(t.pgn);
+}
+
+void worker(Tournament &t){
+	TranspositionTable tables[2];
+	for(TranspositionTable &table : tables)
+		table.resize(t.hash_mb);
+
+	for(int game; !t.stop && (game = t.next++) < t.games;){
+		const std::string &opening = t.openings[game / 2 % t.openings.size()];
+		int white_player = game % 2;
+
+		std::string movetext, termination;
+		int plies;
+		for(TranspositionTable &table : tables)
+			table.clear();		//every game starts cold, whichever games this thread played before
+		Result result = playGame(t, opening, white_player, tables, movetext, termination, plies);
+
+		std::lock_guard<std::mutex> lock(t.mutex);
+		writePgn(t, game, opening, white_player, result, movetext, termination);
+		if(result == DRAW)
+			++t.draws;
+		else if((result == WHITE_WINS) == (white_player == 0))
+			++t.wins;
+		else
+			++t.losses;
+		++t.finished;
+		t.plies += plies;
+
+		fprintf(stderr, "game %d of %d: %s, %s  (A +%d =%d -%d)\n", t.finished, t.games, termination.c_str(),
+				result == DRAW ? "1/2-1/2" : result == WHITE_WINS ? "1-0" : "0-1", t.wins, t.draws, t.losses);
+		if(t.sprt){
+			double llr = sprtLlr(t.wins, t.draws, t.losses, t.elo0, t.elo1);
+			if(llr >= log(0.95 / 0.05) || llr <= log(0.05 / 0.95))
+				t.stop = true;
+		}
+	}
+}
+
+//"depth=5,nodes=10000,qs=0,name=foo" into the player, false on an unknown setting or without a depth, nodes or movetime
+bool parsePlayer(Player &player, const std::string &settings){
+	std::istringstream in(settings);
+	std::string item;
+	bool limited = false;
+	while(std::getline(in, item, ',')){
+		size_t eq = item.find('=');
+		if(eq == std::string::npos)
+			return false;
+		std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+		if(key == "depth")
+			limited |= (player.limits.depth = atoi(value.c_str())) > 0;
+		else if(key == "nodes")
+			limited |= (player.limits.nodes = atoll(value.c_str())) > 0;
+		else if(key == "movetime")
+			limited |= (player.limits.movetime = atoi(value.c_str())) > 0;
+		else if(key == "qs")
+			player.limits.quiescence = atoi(value.c_str());
+		else if(key == "pvs")
+			player.limits.pvs = atoi(value.c_str());
+		else if(key == "aspiration")
+			player.limits.aspiration = atoi(value.c_str());
+		else if(key == "nullmove")
+			player.limits.null_move = atoi(value.c_str());
+		else if(key == "lmr")
+			player.limits.lmr = atoi(value.c_str());
+		else if(key == "name")
+			player.name = value;
+		else
+			return false;
+	}
+	if(player.limits.depth < 1 || player.limits.depth > MAX_PLY)
+		player.limits.depth = MAX_PLY;
+	return limited;
+}
+
+int main(int argc, char *argv[]){
+	Tournament t;
+	std::string settings[2] = {"depth=4", "depth=4"};
+	std::string openings_file, pgn_file = "selfplay.pgn";
+	int rounds = 1, jobs = std::thread::hardware_concurrency(), hash_mb = 16;
+
+	for(int i = 1; i < argc; ++i){
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if(arg == "-A" && has_value)
+			settings[0] = argv[++i];
+		else if(arg == "-B" && has_value)
+			settings[1] = argv[++i];
+		else if(arg == "-r" && has_value)
+			rounds = atoi(argv[++i]);
+		else if(arg == "-j" && has_value)
+			jobs = atoi(argv[++i]);
+		else if(arg == "-H" && has_value)
+			hash_mb = atoi(argv[++i]);
+		else if(arg == "-openings" && has_value)
+			openings_file = argv[++i];
+		else if(arg == "-pgn" && has_value)
+			pgn_file = argv[++i];
+		else if(arg == "-sprt" && i + 2 < argc){
+			t.sprt = true;
+			t.elo0 = atof(argv[++i]);
+			t.elo1 = atof(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [-A settings] [-B settings] [-r rounds] [-j jobs] [-H hash_mb] [-openings file] [-pgn file] [-sprt elo0 elo1]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	for(int i = 0; i < 2; ++i){
+		t.players[i].name = settings[i];
+		if(!parsePlayer(t.players[i], settings[i])){
+			fprintf(stderr, "bad settings %s\n", settings[i].c_str());
+			return 1;
+		}
+	}
+	if(t.players[0].name == t.players[1].name){
+		t.players[0].name = "A " + t.players[0].name;
+		t.players[1].name = "B " + t.players[1].name;
+	}
+
+	if(!openings_file.empty()){
+		std::ifstream in(openings_file);
+		if(!in){
+			fprintf(stderr, "can't open %s\n", openings_file.c_str());
+			return 1;
+		}
+		std::string line;
+		while(std::getline(in, line)){
+			Board board;
+			if(line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+				continue;
+			if(!setupOpening(board, line)){
+				fprintf(stderr, "skipping opening %s\n", line.c_str());
+				continue;
+			}
+			t.openings.push_back(line);
+		}
+	} else {
+		t.openings.assign(defaultOpenings, defaultOpenings + sizeof(defaultOpenings) / sizeof(*defaultOpenings));
+	}
+	if(t.openings.empty()){
+		fprintf(stderr, "no openings\n");
+		return 1;
+	}
+
+	t.pgn = fopen(pgn_file.c_str(), "w");
+	if(!t.pgn){
+		fprintf(stderr, "can't write %s\n", pgn_file.c_str());
+		return 1;
+	}
+	t.games = 2 * rounds * t.openings.size();
+	if(jobs < 1)
+		jobs = 1;
+
+	t.hash_mb = hash_mb < 1 ? 1 : hash_mb;
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for(int i = 0; i < jobs; ++i)
+		workers.emplace_back(worker, std::ref(t));
+	for(std::thread &w : workers)
+		w.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fclose(t.pgn);
+
+	int n = t.wins + t.draws + t.losses;
+	printf("%s vs %s: %d games, +%d =%d -%d\n", t.players[0].name.c_str(), t.players[1].name.c_str(), n, t.wins, t.draws, t.losses);
+	if(n){
+		double score = (t.wins + t.draws / 2.0) / n;
+		double variance = (t.wins * pow(1 - score, 2) + t.draws * pow(0.5 - score, 2) + t.losses * pow(score, 2)) / n;
+		double margin = 1.96 * sqrt(variance / n);
+		printf("score %.1f%%", 100 * score);
+		if(score > 0 && score < 1){
+			double low = std::max(score - margin, 1e-6), high = std::min(score + margin, 1 - 1e-6);
+			printf(", elo %+.1f (95%%: %+.1f to %+.1f)", eloFromScore(score), eloFromScore(low), eloFromScore(high));
+		}
+		printf("\n");
+	}
+	if(t.sprt){
+		double llr = sprtLlr(t.wins, t.draws, t.losses, t.elo0, t.elo1);
+		printf("sprt elo0 %.1f elo1 %.1f: llr %.2f (%.2f, %.2f), %s\n", t.elo0, t.elo1, llr, log(0.05 / 0.95), log(0.95 / 0.05),
+				llr >= log(0.95 / 0.05) ? "H1 accepted" : llr <= log(0.05 / 0.95) ? "H0 accepted" : "inconclusive");
+	}
+	printf("%d jobs, %.1f s, %.0f games/hour, %.0f plies/game\n", jobs, seconds, seconds > 0 ? n * 3600 / seconds : 0.0,
+			n ? (double)t.plies / n : 0.0);
+	return 0;
+}
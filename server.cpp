@@ -0,0 +1,391 @@
+/* Engine service: many games at once over a Unix domain socket, one game session per connection.
+	Searches from all sessions are queued and run on a fixed pool of worker threads that share one hash table,
+	the session that has had the least search time so far goes first. A report line (moves/s, p50/p99 move latency,
+	queue depth) is printed every few seconds. POSIX only.
+	build: g++ -O2 -pthread server.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp -o server
+	usage: server [-s socket] [-w workers] [-H hash_mb] [-m max_movetime] [-r report_seconds]
+	protocol, a command per line, every one answered by a line:
+		position startpos | fen <fen> [moves <move>...]		set up the game -> ok
+		move <move>...				play moves on the session's board -> ok
+		clock <ms> [<inc>]			give the session a time budget: a go without movetime spends it like a game clock,
+									only the time searched is charged (not the time queued) and inc is added per move -> ok
+		go [movetime <ms>] [depth <n>] [nodes <n>]
+									queue a search of the session's position
+									-> bestmove <move>|0000 score <cp> depth <n> nodes <n> wait <ms> time <ms> [clock <ms>]
+		stop						answer the queued or running search now (the answer comes as the go's bestmove line)
+		stats						-> stats sessions <n> workers <n> busy <n> queue <n> moves <n> p50 <ms> p99 <ms>
+		quit
+	errors come back as "error <text>", a session has at most one search queued or running
+*/
+#include "chess.h"
+#include "tt.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<condition_variable>
+#include<cerrno>
+#include<csignal>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<memory>
+#include<mutex>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<unistd.h>
+
+#define MAX_LINE 65536			//longer lines end the connection
+#define LATENCY_WINDOW 4096		//percentiles are over this many of the latest moves
+
+struct Session{
+	int fd;
+	Board board;
+	std::mutex write_mutex;		//the reader and a worker both answer
+
+	//guarded by queueMutex
+	int budget = 0, inc = 0;	//ms left on the session's clock and added per move
+	bool clocked = false;
+	bool busy = false;			//a search is queued or running
+	long long served = 0;		//ms searched for this session, the fair queue's key
+	std::atomic<bool> stop;
+
+	Session(int fd) : fd(fd), stop(false){}
+	~Session(){ close(fd); }
+};
+
+struct Job{
+	std::shared_ptr<Session> session;
+	Board board;
+	SearchLimits limits;
+	Clock::time_point queued;
+	long long seq;
+};
+
+int maxMovetime = 1000;
+
+std::mutex queueMutex;
+std::condition_variable queueReady, searchDone;
+std::vector<Job> queue;
+long long jobSeq = 0;
+long long virtualTime = 0;		//served of the last job started, where a session coming back from idle rejoins
+int workers = 0, busyWorkers = 0, sessionCount = 0, maxQueue = 0;
+long long moves = 0;
+int latencies[LATENCY_WINDOW];		//ms from go to bestmove, a ring buffer
+std::atomic<bool> shuttingDown(false);
+
+void send(Session &s, const std::string &line){
+	std::lock_guard<std::mutex> lock(s.write_mutex);
+	std::string out = line + "\n";
+	for(size_t sent = 0; sent < out.size(); ){
+		ssize_t n = ::send(s.fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+		if(n <= 0)
+			return;		//the client is gone, its reader notices and ends the session
+		sent += n;
+	}
+}
+
+//a percentile of the latest move latencies in ms, queueMutex held
+int latencyPercentile(int percent){
+	int n = (int)std::min<long long>(moves, LATENCY_WINDOW);
+	if(n == 0)
+		return 0;
+	std::vector<int> sorted(latencies, latencies + n);
+	int k = (int)((long long)(n - 1) * percent / 100);
+	std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+	return sorted[k];
+}
+
+//the fair queue: the job of the session that has been served least, first come first served between equals
+void worker(){
+	for(;;){
+		std::unique_lock<std::mutex> lock(queueMutex);
+		queueReady.wait(lock, []{ return !queue.empty() || shuttingDown; });
+		if(shuttingDown)
+			return;
+		auto next = std::min_element(queue.begin(), queue.end(), [](const Job &a, const Job &b){
+			return a.session->served != b.session->served ? a.session->served < b.session->served : a.seq < b.seq;
+		});
+		Job job = std::move(*next);
+		queue.erase(next);
+		virtualTime = std::max(virtualTime, job.session->served);
+		++busyWorkers;
+		lock.unlock();
+
+		Clock::time_point start = Clock::now();
+		SearchInfo info;
+		info.pv_length = 0;
+		Coordinate from, to;
+		getMoveToMake(from, to, job.board, job.limits, job.board.turn, &info);
+		Clock::time_point end = Clock::now();
+		int searched = (int)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+		int waited = (int)std::chrono::duration_cast<std::chrono::milliseconds>(start - job.queued).count();
+
+		Session &s = *job.session;
+		std::ostringstream answer;
+		answer << "bestmove " << (info.move != Move() ? moveToString(info.move) : std::string("0000")) << " score " << info.score
+			<< " depth " << info.depth << " nodes " << info.nodes << " wait " << waited << " time " << searched;
+
+		lock.lock();
+		s.served += std::max(searched, 1);
+		if(s.clocked){
+			s.budget = std::max(s.budget - searched, 0) + s.inc;
+			answer << " clock " << s.budget;
+		}
+		s.busy = false;
+		--busyWorkers;
+		latencies[moves++ % LATENCY_WINDOW] = waited + searched;
+		lock.unlock();
+		searchDone.notify_all();
+
+		send(s, answer.str());
+	}
+}
+
+//go [movetime <ms>] [depth <n>] [nodes <n>], queues the search or says why not
+bool go(const std::shared_ptr<Session> &session, std::istringstream &in, std::string &error){
+	Session &s = *session;
+	SearchLimits limits;
+	limits.new_generation = false;
+
+	std::string token;
+	while(in >> token){
+		if(token == "movetime")
+			in >> limits.movetime;
+		else if(token == "depth")
+			in >> limits.depth;
+		else if(token == "nodes")
+			in >> limits.nodes;
+	}
+	limits.depth = std::max(1, std::min(limits.depth, (int)MAX_PLY));
+	limits.stop = &s.stop;
+
+	std::lock_guard<std::mutex> lock(queueMutex);
+	if(s.busy){
+		error = "busy";
+		return false;
+	}
+	if(limits.movetime <= 0 && s.clocked){
+		if(s.budget > 0){
+			limits.time[0] = limits.time[1] = s.budget;
+			limits.inc[0] = limits.inc[1] = s.inc;
+		} else {
+			limits.depth = 1;		//out of time: the quickest legal answer
+		}
+	}
+	//no worker is held longer than the cap, whatever the session asked for or has on its clock
+	if(limits.movetime <= 0 && (!s.clocked || allocateTime(limits, s.board.turn) > maxMovetime))
+		limits.movetime = maxMovetime;
+	limits.movetime = std::min(limits.movetime, maxMovetime);
+
+	//a session that was idle (or is new) starts level with the ones being served instead of with the credit it saved up
+	s.served = std::max(s.served, virtualTime);
+
+	s.busy = true;
+	s.stop = false;
+	queue.push_back(Job{session, s.board, limits, Clock::now(), jobSeq++});
+	maxQueue = std::max(maxQueue, (int)queue.size());
+	queueReady.notify_one();
+	return true;
+}
+
+std::string stats(){
+	std::lock_guard<std::mutex> lock(queueMutex);
+	std::ostringstream out;
+	out << "stats sessions " << sessionCount << " workers " << workers << " busy " << busyWorkers << " queue " << queue.size()
+		<< " moves " << moves << " p50 " << latencyPercentile(50) << " p99 " << latencyPercentile(99);
+	return out.str();
+}
+
+//reads the session's commands till quit or disconnect
+void serve(std::shared_ptr<Session> session){
+	Session &s = *session;
+
+	std::string buffer;
+	char chunk[4096];
+	bool open = true;
+	while(open){
+		size_t end;
+		while((end = buffer.find('\n')) == std::string::npos){
+			ssize_t n = recv(s.fd, chunk, sizeof(chunk), 0);
+			if(n <= 0 || buffer.size() > MAX_LINE){
+				open = false;
+				break;
+			}
+			buffer.append(chunk, n);
+		}
+		if(!open)
+			break;
+		std::string line = buffer.substr(0, end);
+		buffer.erase(0, end + 1);
+		if(!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		std::istringstream in(line);
+		std::string command, error;
+		in >> command;
+		if(command.empty())
+			continue;
+
+		bool idle;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			idle = !s.busy;
+		}
+		if(command == "position"){
+			if(idle && setPosition(s.board, in, error))
+				send(s, "ok");
+			else
+				send(s, "error " + (idle ? error : std::string("busy")));
+		} else if(command == "move"){
+			std::string token;
+			Board b = s.board;
+			while(idle && in >> token){
+				Move m = parseMove(b, token);
+				if(m == Move()){
+					error = "illegal move " + token;
+					break;
+				}
+				playMove(b, m);
+			}
+			if(idle && error.empty()){
+				s.board = b;
+				send(s, "ok");
+			} else {
+				send(s, "error " + (idle ? error : std::string("busy")));
+			}
+		} else if(command == "clock"){
+			int budget = -1, inc = 0;
+			in >> budget >> inc;
+			if(budget < 0 || inc < 0){
+				send(s, "error expected clock <ms> [<inc>]");
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(queueMutex);
+			s.clocked = budget > 0;
+			s.budget = budget;
+			s.inc = inc;
+			send(s, "ok");
+		} else if(command == "go"){
+			if(!go(session, in, error))
+				send(s, "error " + error);
+		} else if(command == "stop"){
+			s.stop = true;
+		} else if(command == "stats"){
+			send(s, stats());
+		} else if(command == "quit"){
+			open = false;
+		} else {
+			send(s, "error unknown command " + command);
+		}
+	}
+
+	//a queued search is dropped, a running one stopped and waited for, so no worker answers a closed session
+	std::unique_lock<std::mutex> lock(queueMutex);
+	s.stop = true;
+	for(auto it = queue.begin(); it != queue.end(); ++it){
+		if(it->session == session){
+			queue.erase(it);
+			s.busy = false;
+			break;
+		}
+	}
+	searchDone.wait(lock, [&]{ return !s.busy; });
+	--sessionCount;
+}
+
+//ages the shared hash table once a second and prints a report line every report_seconds
+void housekeeping(int report_seconds){
+	Clock::time_point last_report = Clock::now();
+	long long last_moves = 0;
+	while(!shuttingDown){
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		transpositionTable.newSearch();
+
+		double elapsed = std::chrono::duration<double>(Clock::now() - last_report).count();
+		if(report_seconds <= 0 || elapsed < report_seconds)
+			continue;
+		std::lock_guard<std::mutex> lock(queueMutex);
+		printf("sessions %d busy %d/%d queue %d (max %d) moves/s %.1f p50 %d ms p99 %d ms\n", sessionCount, busyWorkers, workers,
+				(int)queue.size(), maxQueue, (moves - last_moves) / elapsed, latencyPercentile(50), latencyPercentile(99));
+		fflush(stdout);
+		last_report = Clock::now();
+		last_moves = moves;
+		maxQueue = (int)queue.size();
+	}
+}
+
+int main(int argc, char *argv[]){
+	std::string path = "/tmp/chess.sock";
+	int hash_mb = 64, report_seconds = 10;
+	workers = std::thread::hardware_concurrency();
+
+	for(int i = 1; i < argc; ++i){
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if(arg == "-s" && has_value)
+			path = argv[++i];
+		else if(arg == "-w" && has_value)
+			workers = atoi(argv[++i]);
+		else if(arg == "-H" && has_value)
+			hash_mb = atoi(argv[++i]);
+		else if(arg == "-m" && has_value)
+			maxMovetime = atoi(argv[++i]);
+		else if(arg == "-r" && has_value)
+			report_seconds = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-s socket] [-w workers] [-H hash_mb] [-m max_movetime] [-r report_seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+	workers = std::max(workers, 1);
+	maxMovetime = std::max(maxMovetime, 1);
+	transpositionTable.resize(std::max(hash_mb, 1));
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(address.sun_path)){
+		fprintf(stderr, "socket path too long\n");
+		return 1;
+	}
+	strcpy(address.sun_path, path.c_str());
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path.c_str());		//left over from a server that didn't shut down
+	if(listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0){
+		fprintf(stderr, "can't listen on %s: %s\n", path.c_str(), strerror(errno));
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	printf("listening on %s, %d workers, %d MB hash, %d ms max per move\n", path.c_str(), workers, hash_mb, maxMovetime);
+	fflush(stdout);
+
+	std::vector<std::thread> pool;
+	for(int i = 0; i < workers; ++i)
+		pool.emplace_back(worker);
+	std::thread(housekeeping, report_seconds).detach();
+
+	for(;;){
+		int fd = accept(listener, nullptr, nullptr);
+		if(fd < 0){
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;
+		}
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			++sessionCount;
+		}
+		std::thread(serve, std::make_shared<Session>(fd)).detach();
+	}
+
+	fprintf(stderr, "accept failed: %s\n", strerror(errno));
+	shuttingDown = true;
+	queueReady.notify_all();
+	for(auto &t : pool)
+		t.join();
+	unlink(path.c_str());
+	return 1;
+}
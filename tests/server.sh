@@ -0,0 +1,48 @@
+#!/bin/sh
+# Protocol checks for the engine service: bad input gets an error line and the daemon keeps serving.
+#	usage: tests/server.sh [path to server]		(build it first, see the top of server.cpp; the client needs python3)
+SERVER=${1:-./server}
+SOCKET=/tmp/chess-test-$$.sock
+failed=0
+
+"$SERVER" -s "$SOCKET" -w 1 -H 1 -r 3600 >/dev/null &
+pid=$!
+trap 'kill $pid 2>/dev/null; rm -f "$SOCKET"' EXIT
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	[ -S "$SOCKET" ] && break
+	sleep 0.5
+done
+
+# ask <commands>: sends the lines on one connection and prints the answer to each
+ask(){
+	printf "$1" | timeout 10 python3 -c '
+import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+f = s.makefile("rw")
+for line in sys.stdin:
+	f.write(line)
+	f.flush()
+	if line.strip() != "quit":
+		print(f.readline().strip())
+' "$SOCKET"
+}
+
+# expect <name> <commands> <pattern the answers must match, one line per command>
+expect(){
+	out=$(ask "$2" | tr '\n' '|')
+	if printf '%s' "$out" | grep -Eq "^$3\$" && kill -0 $pid 2>/dev/null; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1 (got: $out)"
+		failed=1
+	fi
+}
+
+expect "no black king" 'position fen 8/8/8/8/8/8/P7/K7 w - - 0 1\ngo depth 3\nquit\n' 'error invalid fen [^|]*\|bestmove [a-h1-8]{4} [^|]*\|'
+expect "pawn on the back rank" 'position fen 4k3/8/8/8/8/8/8/p3K3 b - - 0 1\nquit\n' 'error invalid fen [^|]*\|'
+expect "king en prise" 'position fen 4k3/8/8/8/8/8/8/4R1K1 w - - 0 1\nquit\n' 'error invalid fen [^|]*\|'
+expect "illegal move" 'position startpos moves e2e5\nquit\n' 'error illegal move e2e5\|'
+expect "serving after errors" 'position fen garbage\nposition startpos moves e2e4\ngo depth 3\nstats\nquit\n' \
+	'error invalid fen [^|]*\|ok\|bestmove [a-h1-8]{4} [^|]*\|stats [^|]*\|'
+exit $failed
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Protocol checks for the uci front end: commands sent back to back with go must reach the search.
+#	usage: tests/uci.sh [path to uci]		(build it first, see the top of uci.cpp)
+UCI=${1:-./uci}
+failed=0
+
+# expect <name> <input> <bestmove count>: the engine must answer within 5 s and exit on quit
+expect(){
+	out=$(printf "$2" | timeout 5 "$UCI")
+	status=$?
+	count=$(printf '%s\n' "$out" | grep -c '^bestmove')
+	if [ $status -ne 0 ] || [ "$count" -ne "$3" ]; then
+		echo "FAIL $1 (exit $status, $count bestmove lines)"
+		failed=1
+	else
+		echo "ok   $1"
+	fi
+}
+
+expect "go infinite then stop" 'go infinite\nstop\nquit\n' 1
+expect "go ponder then stop" 'go ponder movetime 100\nstop\nquit\n' 1
+expect "go ponder then ponderhit" 'go ponder movetime 100\nponderhit\nisready\n' 1
+expect "go then quit" 'go infinite\nquit\n' 1
+expect "stop without a search" 'stop\nquit\n' 0
+expect "mate at the root" 'position fen 7k/6Q1/6K1/8/8/8/8/8 b - - 0 1\ngo depth 3\nisready\n' 1
+exit $failed
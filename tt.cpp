@@ -0,0 +1,89 @@
+#include "tt.h"
+
+#define DEFAULT_HASH_MB 16
+
+TranspositionTable transpositionTable;
+
+//entry data layout: move [0, 16), score [16, 32), depth [32, 40), bound [40, 42), generation [42, 50)
+static uint64_t pack(int depth, int bound, int score, uint16_t move, unsigned generation){
+	return (uint64_t)move | (uint64_t)(uint16_t)(int16_t)score << 16 | (uint64_t)(uint8_t)depth << 32
+		| (uint64_t)bound << 40 | (uint64_t)(generation & 0xff) << 42;
+}
+static int depthOf(uint64_t data){
+	return (data >> 32) & 0xff;
+}
+static unsigned generationOf(uint64_t data){
+	return (data >> 42) & 0xff;
+}
+
+TranspositionTable::TranspositionTable() : generation(0){
+	resize(DEFAULT_HASH_MB);
+}
+
+//not safe while a search is running
+void TranspositionTable::resize(size_t mb){
+	count = (mb << 20) / sizeof(Bucket);
+	if(count == 0)
+		count = 1;
+	buckets.reset(new Bucket[count]);
+	clear();
+}
+
+void TranspositionTable::clear(){
+	for(size_t i = 0; i < count; ++i){
+		for(Entry &e : buckets[i].entries){
+			e.check.store(0, std::memory_order_relaxed);
+			e.data.store(0, std::memory_order_relaxed);
+		}
+	}
+	generation = 0;
+}
+
+//called once per root search so entries from older searches get replaced first
+void TranspositionTable::newSearch(){
+	++generation;
+}
+
+TranspositionTable::Bucket &TranspositionTable::bucketOf(uint64_t key){
+	return buckets[((key & 0xffffffff) * count) >> 32];
+}
+
+bool TranspositionTable::probe(uint64_t key, TTData &data){
+	for(Entry &e : bucketOf(key).entries){
+		uint64_t d = e.data.load(std::memory_order_relaxed);
+		if(d && (e.check.load(std::memory_order_relaxed) ^ d) == key){
+			data.move = d & 0xffff;
+			data.score = (int16_t)(d >> 16);
+			data.depth = depthOf(d);
+			data.bound = (d >> 40) & 3;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, int bound, int score, uint16_t move){
+	Bucket &bucket = bucketOf(key);
+	unsigned current = generation.load(std::memory_order_relaxed);
+	Entry *replace = &bucket.entries[0];
+	int lowest = 1 << 30;
+
+	for(Entry &e : bucket.entries){
+		uint64_t d = e.data.load(std::memory_order_relaxed);
+		if((e.check.load(std::memory_order_relaxed) ^ d) == key){
+			if(!move)
+				move = d & 0xffff;		//keep the old best move
+			replace = &e;
+			break;
+		}
+		//shallow entries of old searches go first
+		int value = depthOf(d) - 8 * ((current - generationOf(d)) & 0xff);
+		if(value < lowest){
+			lowest = value;
+			replace = &e;
+		}
+	}
+	uint64_t data = pack(depth, bound, score, move, current);
+	replace->check.store(key ^ data, std::memory_order_relaxed);
+	replace->data.store(data, std::memory_order_relaxed);
+}
@@ -0,0 +1,49 @@
+#ifndef TT_H
+#define TT_H
+
+#include<atomic>
+#include<cstdint>
+#include<cstddef>
+#include<memory>
+
+enum Bound{
+	BOUND_NONE = 0,
+	BOUND_UPPER = 1,	//score <= alpha, failed low
+	BOUND_LOWER = 2,	//score >= beta, failed high
+	BOUND_EXACT = 3
+};
+
+struct TTData{
+	int score, depth, bound;
+	uint16_t move;
+};
+
+//fixed-size hash of search results, four entries per bucket (one cache line)
+//shared by all search threads without locks: each entry stores key ^ data next to data,
+//so a torn write from two threads shows up as a key mismatch and is ignored
+struct TranspositionTable{
+	TranspositionTable();
+	void resize(size_t mb);
+	void clear();
+	void newSearch();
+	bool probe(uint64_t key, TTData &data);
+	void store(uint64_t key, int depth, int bound, int score, uint16_t move);
+
+private:
+	struct Entry{
+		std::atomic<uint64_t> check, data;
+	};
+	struct alignas(64) Bucket{
+		Entry entries[4];
+	};
+
+	std::unique_ptr<Bucket[]> buckets;
+	size_t count = 0;
+	std::atomic<unsigned> generation;
+
+	Bucket &bucketOf(uint64_t key);
+};
+
+extern TranspositionTable transpositionTable;
+
+#endif
@@ -0,0 +1,222 @@
+/* UCI front end for the engine, for chess GUIs and tournament managers (no Windows dependencies).
+	build: g++ -O2 -pthread uci.cpp chess.cpp bitboard.cpp tt.cpp endgame.cpp eval.cpp book.cpp -o uci
+	the search runs in a SearchSession so stop, ponderhit, isready and quit are answered while it thinks
+*/
+#include "book.h"
+#include "chess.h"
+#include "tt.h"
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<future>
+#include<iostream>
+#include<mutex>
+#include<sstream>
+#include<string>
+#include<thread>
+
+#define MAX_HASH_MB 65536
+
+Board board;
+int threads = 1;
+Book book;
+bool ownBook = true, bestBookMove = false;
+FILE *statsFile = nullptr;		//a JSON line per search goes here when set
+
+SearchSession session;
+std::thread searchThread;		//waits for the session's answer and prints bestmove
+std::atomic<bool> stopSearch(false);
+std::mutex outputMutex;
+
+//lines from the search thread and the input loop must not interleave
+void send(const std::string &line){
+	std::lock_guard<std::mutex> lock(outputMutex);
+	fputs(line.c_str(), stdout);
+	fputc('\n', stdout);
+	fflush(stdout);
+}
+
+//centipawns, or moves to mate
+std::string scoreToString(int score){
+	if(score >= MATE_BOUND)
+		return "mate " + std::to_string((MATE_SCORE - score + 1) / 2);
+	if(score <= -MATE_BOUND)
+		return "mate " + std::to_string(-(MATE_SCORE + score) / 2);
+	return "cp " + std::to_string(score);
+}
+
+void sendInfo(const SearchInfo &info){
+	std::ostringstream out;
+	out << "info depth " << info.depth << " score " << scoreToString(info.score) << " nodes " << info.nodes
+		<< " nps " << (info.time > 0 ? info.nodes * 1000 / info.time : info.nodes) << " time " << info.time;
+	if(info.pv_length > 0){
+		out << " pv";
+		for(int i = 0; i < info.pv_length; ++i)
+			out << ' ' << moveToString(info.pv[i]);
+	}
+	send(out.str());
+}
+
+//ends a running search, its thread prints bestmove before it exits
+void waitForSearch(){
+	if(searchThread.joinable()){
+		stopSearch = true;
+		session.stop();
+		searchThread.join();
+	}
+}
+
+//position [startpos | fen <fen>] [moves <move>...]
+void position(std::istringstream &in){
+	std::string error;
+	if(!setPosition(board, in, error))
+		send("info string " + error);
+}
+
+void go(std::istringstream &in){
+	SearchLimits limits;
+	limits.threads = threads;
+	bool infinite = false, ponder = false;
+
+	std::string token;
+	while(in >> token){
+		if(token == "depth")
+			in >> limits.depth;
+		else if(token == "movetime")
+			in >> limits.movetime;
+		else if(token == "nodes")
+			in >> limits.nodes;
+		else if(token == "wtime")
+			in >> limits.time[0];
+		else if(token == "btime")
+			in >> limits.time[1];
+		else if(token == "winc")
+			in >> limits.inc[0];
+		else if(token == "binc")
+			in >> limits.inc[1];
+		else if(token == "movestogo")
+			in >> limits.movestogo;
+		else if(token == "infinite")
+			infinite = true;
+		else if(token == "ponder")
+			ponder = true;
+	}
+	//a bare go searches till stop as well
+	if(!limits.movetime && !limits.nodes && !limits.time[0] && !limits.time[1] && limits.depth == MAX_PLY)
+		infinite = true;
+
+	limits.progress = sendInfo;
+	stopSearch = false;
+
+	//the search is started here rather than on the waiting thread, so a stop or ponderhit read right after go reaches it
+	Board b = board;
+	SearchInfo book_info;
+	//a pondered position is searched even in book, the answer has to wait for ponderhit anyway
+	book_info.move = ownBook && !ponder ? book.probe(b, bestBookMove) : Move();
+	book_info.pv_length = 0;
+	std::future<SearchInfo> result;
+	if(book_info.move == Move())
+		result = session.start(b, limits, ponder);
+
+	searchThread = std::thread([book_info, infinite, result = std::move(result)]() mutable {
+		SearchInfo info = book_info;
+		if(info.move != Move()){
+			send("info string book move");
+		} else {
+			info = result.get();
+			if(statsFile){
+				fprintf(statsFile, "%s\n", searchStatsJson(info).c_str());
+				fflush(statsFile);
+			}
+		}
+
+		//under go infinite the answer has to wait for stop even if the search ran out of depth
+		while(infinite && !stopSearch)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::string answer = "bestmove " + (info.move != Move() ? moveToString(info.move) : std::string("0000"));
+		if(info.pv_length > 1)
+			answer += " ponder " + moveToString(info.pv[1]);
+		send(answer);
+	});
+}
+
+//setoption name <name> value <value>
+void setOption(std::istringstream &in){
+	std::string token, name, value;
+	in >> token;
+	while(in >> token && token != "value")
+		name += (name.empty() ? "" : " ") + token;
+	std::getline(in >> std::ws, value);		//the rest of the line, a path can have spaces
+
+	if(name == "Hash"){
+		int mb = atoi(value.c_str());
+		transpositionTable.resize(mb < 1 ? 1 : mb > MAX_HASH_MB ? MAX_HASH_MB : mb);
+	} else if(name == "Threads"){
+		int n = atoi(value.c_str());
+		threads = n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : n;
+	} else if(name == "Ponder"){
+		//nothing to set up, the gui decides when to send go ponder
+	} else if(name == "OwnBook"){
+		ownBook = value == "true";
+	} else if(name == "BookFile"){
+		if(value.empty() || value == "<empty>")
+			book.close();
+		else if(!book.open(value))
+			send("info string can't open book " + value);
+	} else if(name == "BestBookMove"){
+		bestBookMove = value == "true";
+	} else if(name == "StatsFile"){
+		if(statsFile)
+			fclose(statsFile);
+		statsFile = value.empty() || value == "<empty>" ? nullptr : fopen(value.c_str(), "a");
+		if(!statsFile && !value.empty() && value != "<empty>")
+			send("info string can't open " + value);
+	} else {
+		send("info string unknown option " + name);
+	}
+}
+
+int main(){
+	std::string line;
+	while(std::getline(std::cin, line)){
+		std::istringstream in(line);
+		std::string command;
+		in >> command;
+
+		if(command == "uci"){
+			send("id name Chess++");
+			send("id author the Chess++ authors");
+			send("option name Hash type spin default 16 min 1 max " + std::to_string(MAX_HASH_MB));
+			send("option name Ponder type check default false");
+			send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+			send("option name OwnBook type check default true");
+			send("option name BookFile type string default <empty>");
+			send("option name BestBookMove type check default false");
+			send("option name StatsFile type string default <empty>");
+			send("uciok");
+		} else if(command == "isready"){
+			send("readyok");
+		} else if(command == "ucinewgame"){
+			waitForSearch();
+			transpositionTable.clear();
+		} else if(command == "position"){
+			waitForSearch();
+			position(in);
+		} else if(command == "go"){
+			waitForSearch();
+			go(in);
+		} else if(command == "stop"){
+			waitForSearch();
+		} else if(command == "ponderhit"){
+			session.ponderhit();
+		} else if(command == "setoption"){
+			waitForSearch();
+			setOption(in);
+		} else if(command == "quit"){
+			break;
+		}
+	}
+	waitForSearch();
+	return 0;
+}